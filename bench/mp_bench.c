@@ -0,0 +1,671 @@
+/**
+ * @file   mp_bench.c
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 20:44:17 2026
+ *
+ * @brief  Mapper benchmark.
+ *
+ * Measures put, get (hit), get (miss), del and each throughput and
+ * per-operation latency percentiles for:
+ *
+ * - Object Mode and Key Mode.
+ * - Fill limits 25%, 50%, 75% and 90%.
+ * - C-string and Slinky keys.
+ * - Uniform, Zipfian and sequential key distributions.
+ *
+ * Integer keys are measured with Integer Mode and with a map
+ * generated by MP_DEFINE_MAP (mapper_gen.h).
+ *
+ * Table allocators (heap, huge-page and arena, see mapper_alloc.h)
+ * are compared with an Integer Mode table, which is larger than the
+ * last-level cache. Lookups are then dominated by cache and TLB
+ * misses, and the difference between allocators is the TLB-miss time
+ * saved by huge pages.
+ *
+ * Results are printed as CSV (default) or JSON.
+ *
+ * Usage: mp_bench [-n <keys>] [-N <big keys>] [-f csv|json] [-o <file>]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include <slinky.h>
+
+#include "mapper.h"
+#include "mapper_gen.h"
+#include "mapper_alloc.h"
+
+
+/** Default number of keys. */
+#define BENCH_DEFAULT_KEYS 200000
+
+/** Default number of keys for allocator comparison (0: skip). */
+#define BENCH_DEFAULT_BIG_KEYS 4000000
+
+/** Latency is sampled for every Nth operation. */
+#define BENCH_LAT_SAMPLE 8
+
+/** Zipfian distribution skew. */
+#define BENCH_ZIPF_S 0.99
+
+
+#define bench_hash_u64( k ) mp_gen_hash_u64( k )
+#define bench_eq_u64( a, b ) ( ( a ) == ( b ) )
+MP_DEFINE_MAP( bench_gmap, uint64_t, void*, bench_hash_u64, bench_eq_u64 )
+
+
+/** Key type. */
+typedef enum bench_key_e { BENCH_CSTR, BENCH_SLINKY, BENCH_U64, BENCH_GEN } bench_key_t;
+
+/** Key distribution. */
+typedef enum bench_dist_e { BENCH_UNIFORM, BENCH_ZIPF, BENCH_SEQ } bench_dist_t;
+
+/** Table allocator. */
+typedef enum bench_alloc_e { BENCH_HEAP, BENCH_HUGE, BENCH_ARENA } bench_alloc_t;
+
+/** Operation. */
+typedef enum bench_op_e { BENCH_PUT, BENCH_GET_HIT, BENCH_GET_MISS, BENCH_DEL, BENCH_EACH, BENCH_OP_CNT } bench_op_t;
+
+static const char* bench_key_name[] = { "cstr", "slinky", "u64", "gen" };
+static const char* bench_dist_name[] = { "uniform", "zipf", "seq" };
+static const char* bench_op_name[] = { "put", "get_hit", "get_miss", "del", "each" };
+static const char* bench_alloc_name[] = { "heap", "huge", "arena" };
+
+
+/** Benchmark case. */
+typedef struct bench_case_s
+{
+    int           key_mode; /**< Key Mode (else Object Mode). */
+    bench_key_t   key;      /**< Key type. */
+    bench_dist_t  dist;     /**< Key distribution. */
+    po_size_t     fill;     /**< Fill limit. */
+    bench_alloc_t alloc;    /**< Table allocator. */
+} bench_case_s;
+
+
+/** Benchmark result for one operation. */
+typedef struct bench_res_s
+{
+    po_size_t ops;  /**< Operation count. */
+    double    mops; /**< Throughput (million operations per second). */
+    double    p50;  /**< Latency 50th percentile (ns). */
+    double    p99;  /**< Latency 99th percentile (ns). */
+    double    p999; /**< Latency 99.9th percentile (ns). */
+} bench_res_s;
+
+
+static po_size_t key_cnt = BENCH_DEFAULT_KEYS;
+static po_size_t big_cnt = BENCH_DEFAULT_BIG_KEYS;
+static char**    cstr_keys;
+static char**    cstr_miss;
+static sl_t*     sl_keys;
+static sl_t*     sl_miss;
+static uint32_t* order;
+static double*   lat;
+static po_size_t lat_cnt;
+static FILE*     out;
+static int       json;
+static int       first_row = 1;
+static uint64_t  rng_state = 0x9E3779B97F4A7C15ULL;
+
+
+
+/* ------------------------------------------------------------
+ * Support:
+ */
+
+static uint64_t bench_rand( void )
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+
+static double bench_now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static int bench_lat_cmp( const void* a, const void* b )
+{
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return ( da > db ) - ( da < db );
+}
+
+
+/**
+ * Fill access order (key indexes) according to distribution.
+ */
+static void bench_order( bench_dist_t dist )
+{
+    double* cdf;
+    double  sum;
+    double  u;
+
+    switch ( dist ) {
+
+        case BENCH_UNIFORM:
+            for ( po_size_t i = 0; i < key_cnt; i++ )
+                order[ i ] = bench_rand() % key_cnt;
+            break;
+
+        case BENCH_ZIPF:
+            cdf = malloc( key_cnt * sizeof( double ) );
+            sum = 0;
+            for ( po_size_t i = 0; i < key_cnt; i++ ) {
+                sum += 1.0 / pow( i + 1, BENCH_ZIPF_S );
+                cdf[ i ] = sum;
+            }
+            for ( po_size_t i = 0; i < key_cnt; i++ ) {
+                po_size_t lo = 0;
+                po_size_t hi = key_cnt - 1;
+                u = ( bench_rand() >> 11 ) * ( 1.0 / 9007199254740992.0 ) * sum;
+                while ( lo < hi ) {
+                    po_size_t mid = ( lo + hi ) / 2;
+                    if ( cdf[ mid ] < u )
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+                /* Scatter popular keys over the key set. */
+                order[ i ] = ( lo * 2654435761u ) % key_cnt;
+            }
+            free( cdf );
+            break;
+
+        case BENCH_SEQ:
+            for ( po_size_t i = 0; i < key_cnt; i++ )
+                order[ i ] = i;
+            break;
+    }
+}
+
+
+/**
+ * Begin operation timing.
+ */
+static double bench_op_begin( po_size_t i )
+{
+    return ( i % BENCH_LAT_SAMPLE == 0 ) ? bench_now() : 0;
+}
+
+
+/**
+ * End operation timing.
+ */
+static void bench_op_end( po_size_t i, double t0 )
+{
+    if ( i % BENCH_LAT_SAMPLE == 0 )
+        lat[ lat_cnt++ ] = bench_now() - t0;
+}
+
+
+/**
+ * Compute result from total time and sampled latencies.
+ */
+static void bench_result( bench_res_s* res, po_size_t ops, double ns )
+{
+    res->ops = ops;
+    res->mops = ( ns > 0 ) ? ops / ( ns / 1e3 ) : 0;
+    res->p50 = res->p99 = res->p999 = 0;
+    if ( lat_cnt > 0 ) {
+        qsort( lat, lat_cnt, sizeof( double ), bench_lat_cmp );
+        res->p50 = lat[ ( lat_cnt * 500 ) / 1000 ];
+        res->p99 = lat[ ( lat_cnt * 990 ) / 1000 ];
+        res->p999 = lat[ ( lat_cnt * 999 ) / 1000 ];
+    }
+    lat_cnt = 0;
+}
+
+
+static void bench_print( bench_case_s* bc, bench_op_t op, bench_res_s* res )
+{
+    const char* mode = bc->key_mode ? "key" : "object";
+
+    if ( json ) {
+        fprintf( out,
+                 "%s\n  { \"mode\": \"%s\", \"key\": \"%s\", \"dist\": \"%s\", \"fill\": %zu, \"op\": \"%s\", "
+                 "\"ops\": %zu, \"mops\": %.3f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, \"alloc\": \"%s\" }",
+                 first_row ? "[" : ",",
+                 mode,
+                 bench_key_name[ bc->key ],
+                 bench_dist_name[ bc->dist ],
+                 (size_t)bc->fill,
+                 bench_op_name[ op ],
+                 (size_t)res->ops,
+                 res->mops,
+                 res->p50,
+                 res->p99,
+                 res->p999,
+                 bench_alloc_name[ bc->alloc ] );
+    } else {
+        if ( first_row )
+            fprintf( out, "mode,key,dist,fill,op,ops,mops,p50_ns,p99_ns,p999_ns,alloc\n" );
+        fprintf( out,
+                 "%s,%s,%s,%zu,%s,%zu,%.3f,%.0f,%.0f,%.0f,%s\n",
+                 mode,
+                 bench_key_name[ bc->key ],
+                 bench_dist_name[ bc->dist ],
+                 (size_t)bc->fill,
+                 bench_op_name[ op ],
+                 (size_t)res->ops,
+                 res->mops,
+                 res->p50,
+                 res->p99,
+                 res->p999,
+                 bench_alloc_name[ bc->alloc ] );
+    }
+    first_row = 0;
+}
+
+
+static void bench_each_fn( po_d value, void* arg )
+{
+    if ( value )
+        ( *(po_size_t*)arg )++;
+}
+
+
+static void bench_each_key_fn( po_d key, po_d value, void* arg )
+{
+    if ( key || value )
+        ( *(po_size_t*)arg )++;
+}
+
+
+static void bench_each_u64_fn( uint64_t key, po_d value, void* arg )
+{
+    if ( key || value )
+        ( *(po_size_t*)arg )++;
+}
+
+
+static void bench_each_gen_fn( uint64_t key, void* value, void* arg )
+{
+    if ( key || value )
+        ( *(po_size_t*)arg )++;
+}
+
+
+
+/* ------------------------------------------------------------
+ * Benchmarks:
+ */
+
+/**
+ * Run all operations for Mapper with string keys (C-string or
+ * Slinky).
+ */
+static void bench_run_mapper( bench_case_s* bc )
+{
+    mp_t        mp;
+    po_d*       keys;
+    po_d*       miss;
+    bench_res_s res[ BENCH_OP_CNT ];
+    double      t0;
+    double      t;
+    po_size_t   cnt;
+
+    if ( bc->key == BENCH_CSTR ) {
+        keys = (po_d*)cstr_keys;
+        miss = (po_d*)cstr_miss;
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, MP_DEFAULT_SIZE, bc->fill );
+    } else {
+        keys = (po_d*)sl_keys;
+        miss = (po_d*)sl_miss;
+        mp = mp_new_full( NULL, mp_key_hash_slinky, mp_key_comp_slinky, MP_DEFAULT_SIZE, bc->fill );
+    }
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        t = bench_op_begin( i );
+        if ( bc->key_mode )
+            mp_put_key( mp, keys[ order[ i ] ], keys[ order[ i ] ] );
+        else
+            mp_put( mp, keys[ order[ i ] ] );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_PUT ], key_cnt, bench_now() - t0 );
+
+    /* Make sure that all keys are present for lookups. */
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        if ( bc->key_mode )
+            mp_put_key( mp, keys[ i ], keys[ i ] );
+        else
+            mp_put( mp, keys[ i ] );
+    }
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        t = bench_op_begin( i );
+        if ( bc->key_mode )
+            mp_get_key( mp, keys[ order[ i ] ] );
+        else
+            mp_get( mp, keys[ order[ i ] ] );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_GET_HIT ], key_cnt, bench_now() - t0 );
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        t = bench_op_begin( i );
+        if ( bc->key_mode )
+            mp_get_key( mp, miss[ order[ i ] ] );
+        else
+            mp_get( mp, miss[ order[ i ] ] );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_GET_MISS ], key_cnt, bench_now() - t0 );
+
+    cnt = 0;
+    t0 = bench_now();
+    if ( bc->key_mode )
+        mp_each_key( mp, bench_each_key_fn, &cnt );
+    else
+        mp_each( mp, bench_each_fn, &cnt );
+    bench_result( &res[ BENCH_EACH ], cnt, bench_now() - t0 );
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        t = bench_op_begin( i );
+        if ( bc->key_mode )
+            mp_del_key( mp, keys[ order[ i ] ] );
+        else
+            mp_del( mp, keys[ order[ i ] ] );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_DEL ], key_cnt, bench_now() - t0 );
+
+    mp_destroy( mp );
+
+    for ( int op = 0; op < BENCH_OP_CNT; op++ )
+        bench_print( bc, op, &res[ op ] );
+}
+
+
+/**
+ * Run all operations for integer keys (Integer Mode or generated
+ * map).
+ */
+static void bench_run_u64( bench_case_s* bc )
+{
+    mp_t         mp = NULL;
+    bench_gmap_t gm = NULL;
+    bench_res_s  res[ BENCH_OP_CNT ];
+    double       t0;
+    double       t;
+    po_size_t    cnt;
+    uint64_t     key;
+
+    if ( bc->key == BENCH_U64 )
+        mp = mp_new_u64( NULL, MP_DEFAULT_SIZE, bc->fill );
+    else
+        gm = bench_gmap_new( NULL, MP_DEFAULT_SIZE, bc->fill );
+
+    /* Keys are even numbers, misses odd numbers. */
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        key = (uint64_t)order[ i ] << 1;
+        t = bench_op_begin( i );
+        if ( mp )
+            mp_put_u64( mp, key, (po_d)( uintptr_t )( key + 1 ) );
+        else
+            bench_gmap_put( gm, key, (void*)( uintptr_t )( key + 1 ) );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_PUT ], key_cnt, bench_now() - t0 );
+
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        key = (uint64_t)i << 1;
+        if ( mp )
+            mp_put_u64( mp, key, (po_d)( uintptr_t )( key + 1 ) );
+        else
+            bench_gmap_put( gm, key, (void*)( uintptr_t )( key + 1 ) );
+    }
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        key = (uint64_t)order[ i ] << 1;
+        t = bench_op_begin( i );
+        if ( mp )
+            mp_get_u64( mp, key );
+        else
+            bench_gmap_get( gm, key );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_GET_HIT ], key_cnt, bench_now() - t0 );
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        key = ( (uint64_t)order[ i ] << 1 ) + 1;
+        t = bench_op_begin( i );
+        if ( mp )
+            mp_get_u64( mp, key );
+        else
+            bench_gmap_get( gm, key );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_GET_MISS ], key_cnt, bench_now() - t0 );
+
+    cnt = 0;
+    t0 = bench_now();
+    if ( mp )
+        mp_each_u64( mp, bench_each_u64_fn, &cnt );
+    else
+        bench_gmap_each( gm, bench_each_gen_fn, &cnt );
+    bench_result( &res[ BENCH_EACH ], cnt, bench_now() - t0 );
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        key = (uint64_t)order[ i ] << 1;
+        t = bench_op_begin( i );
+        if ( mp )
+            mp_del_u64( mp, key );
+        else
+            bench_gmap_del( gm, key, NULL );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_DEL ], key_cnt, bench_now() - t0 );
+
+    if ( mp )
+        mp_destroy( mp );
+    else
+        bench_gmap_destroy( gm );
+
+    for ( int op = 0; op < BENCH_OP_CNT; op++ )
+        bench_print( bc, op, &res[ op ] );
+}
+
+
+
+/**
+ * Run put, get (hit) and get (miss) for a large Integer Mode table
+ * with the allocator of the case. Lookups use uniform random keys.
+ */
+static void bench_run_alloc( bench_case_s* bc )
+{
+    mp_t        mp;
+    mp_alloc_s  huge;
+    mp_arena_t  arena = NULL;
+    bench_res_s res[ BENCH_OP_CNT ];
+    double      t0;
+    double      t;
+    uint64_t    key;
+
+    switch ( bc->alloc ) {
+
+        case BENCH_HEAP:
+            mp = mp_new_u64_alloc( NULL, MP_DEFAULT_SIZE, bc->fill, NULL );
+            break;
+
+        case BENCH_HUGE:
+            mp = mp_new_u64_alloc( NULL, MP_DEFAULT_SIZE, bc->fill, mp_alloc_huge( &huge ) );
+            break;
+
+        default:
+            /* Room for the final table and the ones before it. */
+            arena = mp_arena_new( NULL, ( 800 * big_cnt / bc->fill + 1024 ) * sizeof( po_d ), 1 );
+            mp = mp_new_u64_alloc( NULL, MP_DEFAULT_SIZE, bc->fill, &arena->alloc );
+            break;
+    }
+
+    /* Keys are even numbers, misses odd numbers. */
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < big_cnt; i++ ) {
+        key = (uint64_t)i << 1;
+        t = bench_op_begin( i );
+        mp_put_u64( mp, key, (po_d)( uintptr_t )( key + 1 ) );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_PUT ], big_cnt, bench_now() - t0 );
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < big_cnt; i++ ) {
+        key = ( bench_rand() % big_cnt ) << 1;
+        t = bench_op_begin( i );
+        mp_get_u64( mp, key );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_GET_HIT ], big_cnt, bench_now() - t0 );
+
+    t0 = bench_now();
+    for ( po_size_t i = 0; i < big_cnt; i++ ) {
+        key = ( ( bench_rand() % big_cnt ) << 1 ) + 1;
+        t = bench_op_begin( i );
+        mp_get_u64( mp, key );
+        bench_op_end( i, t );
+    }
+    bench_result( &res[ BENCH_GET_MISS ], big_cnt, bench_now() - t0 );
+
+    mp_destroy( mp );
+    if ( arena )
+        mp_arena_destroy( arena );
+
+    for ( int op = BENCH_PUT; op <= BENCH_GET_MISS; op++ )
+        bench_print( bc, op, &res[ op ] );
+}
+
+/* ------------------------------------------------------------
+ * Main:
+ */
+
+int main( int argc, char** argv )
+{
+    static const po_size_t fills[] = { 25, 50, 75, 90 };
+    bench_case_s           bc;
+    char                   buf[ 32 ];
+
+    out = stdout;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( !strcmp( argv[ i ], "-n" ) && i + 1 < argc ) {
+            key_cnt = strtoul( argv[ ++i ], NULL, 10 );
+        } else if ( !strcmp( argv[ i ], "-N" ) && i + 1 < argc ) {
+            big_cnt = strtoul( argv[ ++i ], NULL, 10 );
+        } else if ( !strcmp( argv[ i ], "-f" ) && i + 1 < argc ) {
+            json = !strcmp( argv[ ++i ], "json" );
+        } else if ( !strcmp( argv[ i ], "-o" ) && i + 1 < argc ) {
+            out = fopen( argv[ ++i ], "w" );
+            if ( out == NULL ) {
+                perror( argv[ i ] );
+                return 1;
+            }
+        } else {
+            fprintf( stderr, "Usage: %s [-n <keys>] [-N <big keys>] [-f csv|json] [-o <file>]\n", argv[ 0 ] );
+            return 1;
+        }
+    }
+
+    if ( key_cnt < 1 )
+        key_cnt = 1;
+
+    cstr_keys = malloc( key_cnt * sizeof( char* ) );
+    cstr_miss = malloc( key_cnt * sizeof( char* ) );
+    sl_keys = malloc( key_cnt * sizeof( sl_t ) );
+    sl_miss = malloc( key_cnt * sizeof( sl_t ) );
+    order = malloc( key_cnt * sizeof( uint32_t ) );
+    lat = malloc( ( ( key_cnt > big_cnt ? key_cnt : big_cnt ) / BENCH_LAT_SAMPLE + 1 ) * sizeof( double ) );
+    lat_cnt = 0;
+
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        snprintf( buf, sizeof( buf ), "key_%zu", (size_t)i );
+        cstr_keys[ i ] = strdup( buf );
+        sl_keys[ i ] = sl_from_str_c( buf );
+        snprintf( buf, sizeof( buf ), "miss_%zu", (size_t)i );
+        cstr_miss[ i ] = strdup( buf );
+        sl_miss[ i ] = sl_from_str_c( buf );
+    }
+
+    bc.alloc = BENCH_HEAP;
+
+    for ( int dist = BENCH_UNIFORM; dist <= BENCH_SEQ; dist++ ) {
+
+        bc.dist = dist;
+        bench_order( dist );
+
+        for ( size_t f = 0; f < sizeof( fills ) / sizeof( fills[ 0 ] ); f++ ) {
+
+            bc.fill = fills[ f ];
+
+            for ( int key = BENCH_CSTR; key <= BENCH_SLINKY; key++ ) {
+                bc.key = key;
+                for ( int key_mode = 0; key_mode < 2; key_mode++ ) {
+                    bc.key_mode = key_mode;
+                    bench_run_mapper( &bc );
+                }
+            }
+
+            bc.key_mode = 1;
+            for ( int key = BENCH_U64; key <= BENCH_GEN; key++ ) {
+                bc.key = key;
+                bench_run_u64( &bc );
+            }
+        }
+    }
+
+    if ( big_cnt > 0 ) {
+        bc.key_mode = 1;
+        bc.key = BENCH_U64;
+        bc.dist = BENCH_UNIFORM;
+        bc.fill = 50;
+        for ( int alloc = BENCH_HEAP; alloc <= BENCH_ARENA; alloc++ ) {
+            bc.alloc = alloc;
+            bench_run_alloc( &bc );
+        }
+    }
+
+    if ( json )
+        fprintf( out, "\n]\n" );
+
+    for ( po_size_t i = 0; i < key_cnt; i++ ) {
+        free( cstr_keys[ i ] );
+        free( cstr_miss[ i ] );
+        sl_del( &sl_keys[ i ] );
+        sl_del( &sl_miss[ i ] );
+    }
+    free( cstr_keys );
+    free( cstr_miss );
+    free( sl_keys );
+    free( sl_miss );
+    free( order );
+    free( lat );
+
+    if ( out != stdout )
+        fclose( out );
+
+    return 0;
+}
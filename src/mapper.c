@@ -11,14 +11,168 @@
 #include <stdlib.h>
 
 #include "mapper.h"
+#include "mapper_gen.h"
 #include "slinky.h"
 #include "ag_hash.h"
 
+#if MP_USE_THREADS == 1
+#include <pthread.h>
+#endif
 
+#if MP_USE_STATS == 1
+#include <time.h>
+#endif
+
+
+#if MP_USE_TAGS == 1
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+/** Number of tags probed at once. */
+#define MP_TAG_GROUP 32
+#elif defined( __SSE2__ )
+#include <emmintrin.h>
+#define MP_TAG_GROUP 16
+#else
+#define MP_TAG_GROUP 16
+#endif
+
+/** Tag for empty slot. Used slots have 7 bits of hash as tag. */
+#define MP_TAG_EMPTY 0x80
+
+#endif
+
+
+/** Number of keys hashed and prefetched together in batch lookup, and
+ * prefetch distance of batch put. */
+#define MP_BATCH_SIZE 16
+
+/** Set operations. */
+#define MP_SET_UNION 0
+#define MP_SET_INTERSECT 1
+#define MP_SET_DIFF 2
+
+
+#if MP_USE_MISS_CNT == 1
+/** Saturated probe distance, real distance is computed from hash. */
+#define MP_DIST_SAT 255
+#endif
+
+
+#if MP_USE_POW2 == 1
+/** Fibonacci hashing multiplier (2^64 / golden ratio). */
+#define MP_FIB_MULT 0x9E3779B97F4A7C15ULL
+#endif
+
+
+#if MP_USE_CUCKOO == 1
+/** Multipliers for selecting the two buckets of key. */
+#define MP_CUCKOO_MULT_1 0x9E3779B97F4A7C15ULL
+#define MP_CUCKOO_MULT_2 0xC2B2AE3D27D4EB4FULL
+#if MP_USE_SPLIT == 1
+/** Table size unit (pointers), i.e. key line and value line. */
+#define MP_CUCKOO_UNIT ( 2 * MP_CUCKOO_LINE )
+#else
+/** Table size unit (pointers), i.e. bucket. */
+#define MP_CUCKOO_UNIT MP_CUCKOO_LINE
+#endif
+#endif
+
+
+#if MP_USE_STATS == 1
+/** Add to statistics counter. */
+#define MP_STAT( mp, cnt, n ) ( ( mp )->stats.cnt += ( n ) )
+#else
+#define MP_STAT( mp, cnt, n )
+#endif
+
+
+static po_size_t mp_slot_cnt( mp_t mp, po_size_t stride );
+static po_size_t mp_key_pos( mp_t mp, po_size_t slot, po_size_t stride );
+static po_size_t mp_value_pos( mp_t mp, po_size_t slot, po_size_t stride );
+static po_size_t mp_wrap( po_size_t pos, po_size_t size );
 static po_size_t mp_next_pos( po_size_t pos, po_size_t size );
-static po_size_t mp_next_key_pos( po_size_t pos, po_size_t size );
-static void      mp_rehash( mp_t mp, po_size_t new_size );
-static void      mp_rehash_key( mp_t mp, po_size_t new_size );
+static po_size_t mp_home( ag_hash_t hash, po_size_t cnt );
+static po_size_t mp_home_slot( mp_t mp, ag_hash_t hash, po_size_t stride );
+static po_size_t mp_size_fix( po_size_t size );
+static po_size_t mp_find( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride, int* found );
+static int       mp_match( mp_t mp, po_size_t slot, const po_d item, const po_d key, ag_hash_t hash );
+#if MP_USE_MISS_CNT == 1
+static po_size_t mp_dist( mp_t mp, po_size_t slot, po_size_t stride );
+static void      mp_dist_set( mp_t mp, po_size_t slot, po_size_t dist );
+#endif
+#if MP_USE_CUCKOO == 1
+static po_size_t mp_cuckoo_width( po_size_t stride );
+static po_size_t mp_cuckoo_bkt_cnt( mp_t mp, po_size_t stride );
+static void      mp_cuckoo_buckets( mp_t mp, ag_hash_t hash, po_size_t stride, po_size_t* bkt );
+static po_size_t mp_cuckoo_alt( mp_t mp, po_size_t slot, po_size_t stride );
+static po_size_t mp_cuckoo_free( mp_t mp, po_size_t bkt, po_size_t stride );
+static po_size_t mp_cuckoo_room( mp_t mp, ag_hash_t hash, po_size_t stride );
+static po_size_t mp_cuckoo_slot( mp_t mp, po_size_t slot, ag_hash_t hash, po_size_t stride );
+#endif
+static int       mp_place( mp_t mp, po_size_t slot, po_size_t stride, const po_d key, const po_d value, ag_hash_t hash );
+static int       mp_insert_new( mp_t mp, const po_d key, const po_d value, ag_hash_t hash, po_size_t stride );
+static void      mp_remove( mp_t mp, po_size_t slot, po_size_t stride );
+static void      mp_slot_move( mp_t mp, po_size_t dst, po_size_t src, po_size_t stride );
+static ag_hash_t mp_slot_hash( mp_t mp, po_size_t slot, po_size_t stride );
+static po_size_t mp_rehash_range( mp_t mp, mp_t old, po_size_t stride, po_size_t first, po_size_t last, int claim );
+#if MP_USE_THREADS == 1
+static po_size_t mp_rehash_par( mp_t mp, mp_t old, po_size_t stride );
+static void*     mp_rehash_worker( void* arg );
+static void      mp_insert_claim( mp_t mp, const po_d key, const po_d value, ag_hash_t hash, po_size_t stride );
+static void      mp_each_run( mp_t mp, mp_each_fn_p each, mp_each_key_fn_p each_key, mp_combine_fn_p combine, void* acc, po_size_t acc_size, po_size_t thr, po_size_t stride );
+static void*     mp_each_worker( void* arg );
+#endif
+static po_t      mp_table_new( mp_t mp, po_size_t size );
+static void      mp_table_destroy( mp_t mp, po_t table );
+static void      mp_meta_new( mp_t mp );
+static void      mp_meta_destroy( mp_t mp );
+static void      mp_meta_set( mp_t mp, po_size_t slot, po_size_t stride, ag_hash_t hash );
+static void      mp_meta_clear( mp_t mp, po_size_t slot, po_size_t stride );
+static void      mp_meta_move( mp_t mp, po_size_t dst, po_size_t src, po_size_t stride );
+static po_size_t mp_insert( mp_t mp, const po_d key, const po_d value, ag_hash_t hash, po_size_t stride );
+static po_size_t mp_upsert( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride, int* inserted );
+static po_d      mp_lookup( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride );
+static po_d      mp_delete( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride );
+static void      mp_batch_prefetch( mp_t mp, const ag_hash_t* hash, po_size_t grp, po_size_t stride );
+static po_size_t mp_lookup_batch( mp_t mp, const po_d* keys, po_d* result, po_size_t cnt, po_size_t stride );
+static po_size_t mp_set_op( mp_t dst, mp_t a, mp_t b, int op, po_size_t stride );
+static po_size_t mp_set_scan( mp_t dst, mp_t src, mp_t other, int want, int src_value, po_size_t stride );
+static po_size_t mp_fit_size( mp_t mp, po_size_t cnt, po_size_t stride );
+static void      mp_reserve_slots( mp_t mp, po_size_t cnt, po_size_t stride );
+static void      mp_resize( mp_t mp, po_size_t new_size, po_size_t stride );
+static void      mp_shrink_check( mp_t mp, po_size_t stride );
+static void      mp_insert_bulk( mp_t mp, const po_d* keys, const po_d* values, po_size_t cnt, po_size_t stride );
+static void      mp_insert_batch( mp_t mp, const po_d* keys, const po_d* values, po_size_t cnt, po_size_t stride );
+static void      mp_insert_hashed( mp_t mp, const po_d key, const po_d value, ag_hash_t hash, po_size_t stride );
+static po_size_t mp_find_cur( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride, int* found );
+static int       mp_grow( mp_t mp, po_size_t stride );
+static int       mp_rehash( mp_t mp, po_size_t new_size, po_size_t stride );
+static void      mp_incr_step( mp_t mp, po_size_t stride );
+static void      mp_incr_finish( mp_t mp, po_size_t stride );
+static void      mp_incr_abort( mp_t mp );
+static po_size_t mp_occ_size( mp_t mp );
+static void      mp_occ_new( mp_t mp );
+static void      mp_occ_destroy( mp_t mp );
+static int       mp_occ_get( mp_t mp, po_size_t slot );
+static void      mp_occ_set( mp_t mp, po_size_t slot );
+static void      mp_occ_clear( mp_t mp, po_size_t slot );
+static po_size_t mp_next_used( mp_t mp, po_size_t pos, po_size_t stride );
+static po_size_t mp_find_u64( mp_t mp, uint64_t key, int* found );
+static po_size_t mp_upsert_slot_u64( mp_t mp, uint64_t key, int* inserted );
+static int       mp_rehash_u64( mp_t mp, po_size_t new_size );
+#if MP_USE_INCR == 1
+static int       mp_incr_start( mp_t mp, po_size_t new_size, po_size_t stride );
+static void      mp_incr_run( mp_t mp, po_size_t stride, po_size_t budget );
+static void      mp_incr_done( mp_t mp );
+#endif
+#if MP_USE_STATS == 1
+static uint64_t  mp_stats_time( void );
+static void      mp_stats_scan( mp_t mp, mp_stats_s* st, po_size_t stride );
+#endif
+#if MP_USE_STATS == 1 && MP_USE_INCR == 1
+static void      mp_stats_fold( mp_t mp, mp_t old );
+#endif
 
 
 
@@ -39,16 +193,52 @@ mp_t mp_new_full( mp_t mp,
                   po_size_t        size,
                   po_size_t        fill_lim )
 {
-    if ( mp == NULL ) {
+    return mp_new_alloc( mp, key_hash, key_comp, size, fill_lim, NULL );
+}
+
+
+mp_t mp_new_alloc( mp_t             mp,
+                   mp_key_hash_fn_p key_hash,
+                   mp_key_comp_fn_p key_comp,
+                   po_size_t        size,
+                   po_size_t        fill_lim,
+                   mp_alloc_t       alloc )
+{
+    int own;
+
+    own = ( mp == NULL );
+    if ( own ) {
         mp = po_malloc( sizeof( mp_s ) );
     }
-    mp->table = po_new_sized( &mp->table_desc, size );
+    mp->alloc = alloc;
+    mp->table = mp_table_new( mp, mp_size_fix( size ) );
+    if ( mp->table == NULL ) {
+        if ( own )
+            po_free( mp );
+        return NULL;
+    }
     mp->key_hash = key_hash;
     mp->key_comp = key_comp;
     mp->used_cnt = 0;
     mp->fill_lim = fill_lim;
+    mp->shrink_lim = 0;
     mp->rehash_cb = NULL;
     mp->rehash_env = NULL;
+    mp->occ = NULL;
+#if MP_USE_MISS_CNT == 1
+    mp->miss_cnt = MP_DEFAULT_MISS_CNT;
+#endif
+#if MP_USE_INCR == 1
+    mp->old = NULL;
+    mp->incr_step = MP_DEFAULT_INCR_STEP;
+#endif
+#if MP_USE_THREADS == 1
+    mp->rehash_thr = 1;
+#endif
+#if MP_USE_STATS == 1
+    memset( &mp->stats, 0, sizeof( mp_stats_s ) );
+#endif
+    mp_meta_new( mp );
 
     return mp;
 }
@@ -57,20 +247,55 @@ mp_t mp_new_full( mp_t mp,
 mp_t mp_use( mp_t mp, po_t po, mp_key_hash_fn_p key_hash, mp_key_comp_fn_p key_comp, po_size_t fill_lim )
 {
     mp->table = po;
+    mp->alloc = NULL;
     mp->key_hash = key_hash;
     mp->key_comp = key_comp;
     mp->used_cnt = 0;
     mp->fill_lim = fill_lim;
+    mp->shrink_lim = 0;
     mp->rehash_cb = NULL;
     mp->rehash_env = NULL;
+    mp->occ = NULL;
+#if MP_USE_MISS_CNT == 1
+    mp->miss_cnt = MP_DEFAULT_MISS_CNT;
+#endif
+#if MP_USE_INCR == 1
+    mp->old = NULL;
+    mp->incr_step = MP_DEFAULT_INCR_STEP;
+#endif
+#if MP_USE_THREADS == 1
+    mp->rehash_thr = 1;
+#endif
+#if MP_USE_STATS == 1
+    memset( &mp->stats, 0, sizeof( mp_stats_s ) );
+#endif
+    mp_meta_new( mp );
+
+    return mp;
+}
+
+
+mp_t mp_new_u64( mp_t mp, po_size_t size, po_size_t fill_lim )
+{
+    return mp_new_u64_alloc( mp, size, fill_lim, NULL );
+}
+
 
+mp_t mp_new_u64_alloc( mp_t mp, po_size_t size, po_size_t fill_lim, mp_alloc_t alloc )
+{
+    mp = mp_new_alloc( mp, NULL, NULL, size, fill_lim, alloc );
+    if ( mp )
+        mp_occ_new( mp );
     return mp;
 }
 
 
 mp_t mp_destroy( mp_t mp )
 {
-    po_destroy_storage( mp->table );
+    mp_incr_abort( mp );
+    mp_occ_destroy( mp );
+    mp_meta_destroy( mp );
+    mp_table_destroy( mp, mp->table );
     po_free( mp );
     return NULL;
 }
@@ -78,14 +303,35 @@ mp_t mp_destroy( mp_t mp )
 
 void mp_destroy_table( mp_t mp )
 {
-    po_destroy_storage( mp->table );
+    mp_release_meta( mp );
+    mp_table_destroy( mp, mp->table );
+}
+
+
+void mp_release_meta( mp_t mp )
+{
+    mp_incr_abort( mp );
+    mp_occ_destroy( mp );
+    mp_meta_destroy( mp );
 }
 
 
 void mp_clear( mp_t mp )
 {
+    mp_incr_abort( mp );
     mp->used_cnt = 0;
     po_clear( mp->table );
+    if ( mp->occ )
+        memset( mp->occ, 0, mp_occ_size( mp ) );
+#if MP_USE_TAGS == 1
+    memset( mp->tags, MP_TAG_EMPTY, po_size( mp->table ) + MP_TAG_GROUP );
+#endif
+#if MP_USE_CUCKOO == 1
+    mp->stash_cnt = 0;
+#endif
+#if MP_USE_MISS_CNT == 1
+    memset( mp->dist, 0, po_size( mp->table ) );
+#endif
 }
 
 
@@ -96,192 +342,382 @@ void mp_set_rehash_cb( mp_t mp, mp_rehash_fn_p cb, void* env )
 }
 
 
+void mp_set_shrink_lim( mp_t mp, po_size_t shrink_lim )
+{
+    if ( shrink_lim > mp->fill_lim / 4 )
+        shrink_lim = mp->fill_lim / 4;
+    mp->shrink_lim = shrink_lim;
+}
+
+
+#if MP_USE_INCR == 1
+
+void mp_set_incr_step( mp_t mp, po_size_t step )
+{
+    if ( step < 1 )
+        step = 1;
+    mp->incr_step = step;
+}
+
+#endif
+
+
+#if MP_USE_THREADS == 1
+
+void mp_set_rehash_threads( mp_t mp, po_size_t thr )
+{
+    if ( thr < 1 )
+        thr = 1;
+    mp->rehash_thr = thr;
+}
+
+#endif
+
+
+#if MP_USE_MISS_CNT == 1
+
+void mp_set_miss_cnt( mp_t mp, po_size_t miss_cnt )
+{
+    if ( miss_cnt > MP_MAX_MISS_CNT )
+        miss_cnt = MP_MAX_MISS_CNT;
+    mp->miss_cnt = miss_cnt;
+}
+
+#endif
+
+
 po_size_t mp_get_index( mp_t mp, const po_d value )
 {
     po_size_t pos;
+    int       found;
 
-    pos = mp->key_hash( value ) % po_size( mp->table );
-    if ( po_item( mp->table, pos, po_d ) == NULL ) {
-        return pos;
-    } else if ( mp->key_comp( po_item( mp->table, pos, const po_d ), value ) ) {
-        return pos;
-    } else {
-        for ( ;; ) {
-            pos = mp_next_pos( pos, po_size( mp->table ) );
-            if ( po_item( mp->table, pos, po_d ) == NULL ) {
-                return pos;
-            } else if ( mp->key_comp( po_item( mp->table, pos, const po_d ), value ) ) {
-                return pos;
-            }
-        }
-    }
+    mp_incr_finish( mp, 1 );
+    pos = mp_find( mp, value, mp->key_hash( value ), 1, &found );
+    /* With MP_USE_MISS_CNT the slot of a missing key is occupied. */
+    if ( pos == mp_slot_cnt( mp, 1 ) || ( !found && po_item( mp->table, mp_key_pos( mp, pos, 1 ), po_d ) != NULL ) )
+        return MP_NO_INDEX;
+    return pos;
 }
 
 
 po_d mp_get_with_index( mp_t mp, po_size_t index )
 {
+    if ( index >= po_size( mp->table ) )
+        return NULL;
     return po_item( mp->table, index, po_d );
 }
 
 
+po_d mp_get_value_with_index( mp_t mp, po_size_t index )
+{
+    if ( index >= po_size( mp->table ) )
+        return NULL;
+#if MP_USE_SPLIT == 1
+    return po_item( mp->table, mp_value_pos( mp, index, 2 ), po_d );
+#else
+    return po_item( mp->table, mp_value_pos( mp, index >> 1, 2 ), po_d );
+#endif
+}
+
+
 po_size_t mp_get_key_index( mp_t mp, const po_d key )
 {
     po_size_t pos;
+    int       found;
+
+    mp_incr_finish( mp, 2 );
+    pos = mp_find( mp, key, mp->key_hash( key ), 2, &found );
+    /* With MP_USE_MISS_CNT the slot of a missing key is occupied. */
+    if ( pos == mp_slot_cnt( mp, 2 ) || ( !found && po_item( mp->table, mp_key_pos( mp, pos, 2 ), po_d ) != NULL ) )
+        return MP_NO_INDEX;
+    return mp_key_pos( mp, pos, 2 );
+}
 
-    pos = ( mp->key_hash( key ) % ( po_size( mp->table ) >> 1 ) ) << 1;
 
-    if ( po_item( mp->table, pos, po_d ) == NULL ) {
-        return pos;
-    } else if ( mp->key_comp( po_item( mp->table, pos, const po_d ), key ) ) {
-        return pos;
-    } else {
-        for ( ;; ) {
-            pos = mp_next_key_pos( pos, po_size( mp->table ) );
-            if ( po_item( mp->table, pos, po_d ) == NULL ) {
-                return pos;
-            } else if ( mp->key_comp( po_item( mp->table, pos, const po_d ), key ) ) {
-                return pos;
-            }
-        }
-    }
+po_size_t mp_put( mp_t mp, const po_d value )
+{
+    return mp_insert( mp, value, NULL, mp->key_hash( value ), 1 );
 }
 
 
-po_size_t mp_put( mp_t mp, const po_d value )
+po_d mp_get( mp_t mp, const po_d value )
 {
-    if ( ( ( mp->used_cnt * 100 ) / po_size( mp->table ) ) >= mp->fill_lim ) {
-        mp_rehash( mp, po_size( mp->table ) * 2 );
-    }
+    return mp_lookup( mp, value, mp->key_hash( value ), 1 );
+}
+
+
+po_size_t mp_put_key( mp_t mp, const po_d key, const po_d value )
+{
+    return mp_put_key_hashed( mp, key, value, mp->key_hash( key ) );
+}
+
+
+po_d mp_get_key( mp_t mp, const po_d key )
+{
+    return mp_lookup( mp, key, mp->key_hash( key ), 2 );
+}
 
+
+po_d* mp_get_or_put( mp_t mp, const po_d value, int* inserted )
+{
     po_size_t pos;
-    pos = mp_get_index( mp, value );
-    if ( po_item( mp->table, pos, po_d ) == NULL )
-        mp->used_cnt++;
-    po_assign( mp->table, pos, value );
-    return pos;
+    int       ins;
+
+    pos = mp_upsert( mp, value, mp->key_hash( value ), 1, &ins );
+    if ( inserted )
+        *inserted = ins;
+    if ( pos == mp_slot_cnt( mp, 1 ) )
+        return NULL;
+
+    return &po_data( mp->table )[ pos ];
 }
 
 
-po_d mp_get( mp_t mp, const po_d value )
+po_d* mp_upsert_key( mp_t mp, const po_d key, int* inserted )
 {
     po_size_t pos;
-    po_size_t start;
+    int       ins;
 
-    pos = mp->key_hash( value ) % po_size( mp->table );
-    start = pos;
+    pos = mp_upsert( mp, key, mp->key_hash( key ), 2, &ins );
+    if ( inserted )
+        *inserted = ins;
+    if ( pos == mp_slot_cnt( mp, 2 ) )
+        return NULL;
+
+    return &po_data( mp->table )[ mp_value_pos( mp, pos, 2 ) ];
+}
 
-    do {
 
-        if ( po_item( mp->table, pos, po_d ) == NULL )
-            return NULL;
+po_size_t mp_get_batch( mp_t mp, const po_d* values, po_d* result, po_size_t cnt )
+{
+    return mp_lookup_batch( mp, values, result, cnt, 1 );
+}
 
-        if ( mp->key_comp( po_item( mp->table, pos, const po_d ), value ) )
-            return po_item( mp->table, pos, po_d );
 
-        pos = mp_next_pos( pos, po_size( mp->table ) );
+po_size_t mp_get_key_batch( mp_t mp, const po_d* keys, po_d* result, po_size_t cnt )
+{
+    return mp_lookup_batch( mp, keys, result, cnt, 2 );
+}
 
-    } while ( start != pos );
 
-    return NULL;
+void mp_reserve( mp_t mp, po_size_t cnt )
+{
+    mp_reserve_slots( mp, cnt, 1 );
 }
 
 
-po_size_t mp_put_key( mp_t mp, const po_d key, const po_d value )
+void mp_reserve_key( mp_t mp, po_size_t cnt )
 {
-    if ( ( ( mp->used_cnt * 100 ) / po_size( mp->table ) ) >= mp->fill_lim ) {
-        mp_rehash_key( mp, po_size( mp->table ) * 2 );
-    }
+    mp_reserve_slots( mp, cnt, 2 );
+}
 
-    po_size_t pos;
-    pos = mp_get_key_index( mp, key );
-    if ( po_item( mp->table, pos, po_d ) == NULL )
-        mp->used_cnt += 2;
-    po_assign( mp->table, pos, key );
-    po_assign( mp->table, pos + 1, value );
-    return pos;
+
+void mp_build( mp_t mp, const po_d* values, po_size_t cnt )
+{
+    mp_insert_bulk( mp, values, NULL, cnt, 1 );
 }
 
 
-po_d mp_get_key( mp_t mp, const po_d key )
+void mp_build_key( mp_t mp, const po_d* keys, const po_d* values, po_size_t cnt )
 {
-    po_size_t pos;
-    po_size_t start;
+    mp_insert_bulk( mp, keys, values, cnt, 2 );
+}
+
+
+void mp_put_batch( mp_t mp, const po_d* values, po_size_t cnt )
+{
+    mp_insert_batch( mp, values, NULL, cnt, 1 );
+}
+
+
+void mp_put_key_batch( mp_t mp, const po_d* keys, const po_d* values, po_size_t cnt )
+{
+    mp_insert_batch( mp, keys, values, cnt, 2 );
+}
+
+
+po_size_t mp_union( mp_t dst, mp_t a, mp_t b )
+{
+    return mp_set_op( dst, a, b, MP_SET_UNION, 1 );
+}
 
-    pos = ( mp->key_hash( key ) % ( po_size( mp->table ) >> 1 ) ) << 1;
-    start = pos;
 
-    do {
+po_size_t mp_union_key( mp_t dst, mp_t a, mp_t b )
+{
+    return mp_set_op( dst, a, b, MP_SET_UNION, 2 );
+}
+
 
-        if ( po_item( mp->table, pos, po_d ) == NULL )
-            return NULL;
+po_size_t mp_intersect( mp_t dst, mp_t a, mp_t b )
+{
+    return mp_set_op( dst, a, b, MP_SET_INTERSECT, 1 );
+}
 
-        if ( mp->key_comp( po_item( mp->table, pos, const po_d ), key ) )
-            return po_item( mp->table, pos + 1, po_d );
 
-        pos = mp_next_key_pos( pos, po_size( mp->table ) );
+po_size_t mp_intersect_key( mp_t dst, mp_t a, mp_t b )
+{
+    return mp_set_op( dst, a, b, MP_SET_INTERSECT, 2 );
+}
 
-    } while ( start != pos );
 
-    return NULL;
+po_size_t mp_diff( mp_t dst, mp_t a, mp_t b )
+{
+    return mp_set_op( dst, a, b, MP_SET_DIFF, 1 );
 }
 
 
-po_d mp_del( mp_t mp, const po_d value )
+po_size_t mp_diff_key( mp_t dst, mp_t a, mp_t b )
+{
+    return mp_set_op( dst, a, b, MP_SET_DIFF, 2 );
+}
+
+
+void mp_compact( mp_t mp )
+{
+    mp_incr_finish( mp, 1 );
+    mp_resize( mp, mp_fit_size( mp, mp->used_cnt, 1 ), 1 );
+}
+
+
+void mp_compact_key( mp_t mp )
+{
+    mp_incr_finish( mp, 2 );
+    mp_resize( mp, mp_fit_size( mp, mp->used_cnt / 2, 2 ), 2 );
+}
+
+
+po_size_t mp_put_u64( mp_t mp, uint64_t key, const po_d value )
 {
     po_size_t pos;
-    po_size_t start;
-    po_d      ret;
+    int       inserted;
+
+    pos = mp_upsert_slot_u64( mp, key, &inserted );
+    if ( pos == mp_slot_cnt( mp, 2 ) )
+        return MP_NO_INDEX;
+    po_assign( mp->table, mp_value_pos( mp, pos, 2 ), value );
+    return mp_key_pos( mp, pos, 2 );
+}
+
 
-    pos = mp->key_hash( value ) % po_size( mp->table );
-    start = pos;
+po_d* mp_upsert_u64( mp_t mp, uint64_t key, int* inserted )
+{
+    po_size_t pos;
+    int       ins;
 
-    do {
+    pos = mp_upsert_slot_u64( mp, key, &ins );
+    if ( inserted )
+        *inserted = ins;
+    if ( pos == mp_slot_cnt( mp, 2 ) )
+        return NULL;
 
-        if ( po_item( mp->table, pos, po_d ) == NULL )
-            return NULL;
+    return &po_data( mp->table )[ mp_value_pos( mp, pos, 2 ) ];
+}
 
-        if ( mp->key_comp( po_item( mp->table, pos, const po_d ), value ) ) {
-            ret = po_item( mp->table, pos, po_d );
-            po_assign( mp->table, pos, NULL );
-            mp->used_cnt--;
-            return ret;
-        }
 
-        pos = mp_next_pos( pos, po_size( mp->table ) );
+po_d mp_get_u64( mp_t mp, uint64_t key )
+{
+    po_size_t pos;
+    int       found;
+
+    pos = mp_find_u64( mp, key, &found );
+    if ( found )
+        return po_item( mp->table, mp_value_pos( mp, pos, 2 ), po_d );
+    else
+        return NULL;
+}
 
-    } while ( start != pos );
 
-    return NULL;
+po_d mp_del( mp_t mp, const po_d value )
+{
+    return mp_delete( mp, value, mp->key_hash( value ), 1 );
 }
 
 
 po_d mp_del_key( mp_t mp, const po_d key )
 {
-    po_size_t pos;
-    po_size_t start;
+    return mp_delete( mp, key, mp->key_hash( key ), 2 );
+}
+
+
+po_d mp_del_u64( mp_t mp, uint64_t key )
+{
+    po_size_t cnt;
+    po_size_t hole;
+    po_size_t home;
+    int       found;
     po_d      ret;
 
-    pos = ( mp->key_hash( key ) % ( po_size( mp->table ) >> 1 ) ) << 1;
-    start = pos;
+    hole = mp_find_u64( mp, key, &found );
+    if ( !found )
+        return NULL;
+
+    ret = po_item( mp->table, mp_value_pos( mp, hole, 2 ), po_d );
+    mp->used_cnt -= 2;
+
+    /* Backward-shift deletion (see mp_remove()). */
+    cnt = mp_slot_cnt( mp, 2 );
+    mp_occ_clear( mp, hole );
+    for ( po_size_t pos = mp_next_pos( hole, cnt ); mp_occ_get( mp, pos ); pos = mp_next_pos( pos, cnt ) ) {
+        home = mp_home( mp_gen_hash_u64( po_item( mp->table, mp_key_pos( mp, pos, 2 ), uintptr_t ) ), cnt );
+        if ( mp_wrap( pos + cnt - home, cnt ) >= mp_wrap( pos + cnt - hole, cnt ) ) {
+            po_assign( mp->table, mp_key_pos( mp, hole, 2 ), po_item( mp->table, mp_key_pos( mp, pos, 2 ), po_d ) );
+            po_assign( mp->table, mp_value_pos( mp, hole, 2 ), po_item( mp->table, mp_value_pos( mp, pos, 2 ), po_d ) );
+            mp_occ_set( mp, hole );
+            mp_occ_clear( mp, pos );
+            hole = pos;
+        }
+    }
+
+    po_assign( mp->table, mp_key_pos( mp, hole, 2 ), NULL );
+    po_assign( mp->table, mp_value_pos( mp, hole, 2 ), NULL );
+    mp_shrink_check( mp, 2 );
+    return ret;
+}
 
-    do {
 
-        if ( po_item( mp->table, pos, po_d ) == NULL )
-            return NULL;
 
-        if ( mp->key_comp( po_item( mp->table, pos, const po_d ), key ) ) {
-            ret = po_item( mp->table, pos + 1, po_d );
-            po_assign( mp->table, pos, NULL );
-            po_assign( mp->table, pos + 1, NULL );
-            mp->used_cnt -= 2;
-            return ret;
-        }
+/* ------------------------------------------------------------
+ * Pre-hashed access:
+ */
 
-        pos = mp_next_key_pos( pos, po_size( mp->table ) );
+po_size_t mp_put_hashed( mp_t mp, const po_d value, ag_hash_t hash )
+{
+    return mp_insert( mp, value, NULL, hash, 1 );
+}
 
-    } while ( start != pos );
 
-    return NULL;
+po_d mp_get_hashed( mp_t mp, const po_d value, ag_hash_t hash )
+{
+    return mp_lookup( mp, value, hash, 1 );
+}
+
+
+po_d mp_del_hashed( mp_t mp, const po_d value, ag_hash_t hash )
+{
+    return mp_delete( mp, value, hash, 1 );
+}
+
+
+po_size_t mp_put_key_hashed( mp_t mp, const po_d key, const po_d value, ag_hash_t hash )
+{
+    po_size_t pos;
+
+    pos = mp_insert( mp, key, value, hash, 2 );
+    if ( pos == MP_NO_INDEX )
+        return MP_NO_INDEX;
+    return mp_key_pos( mp, pos, 2 );
+}
+
+
+po_d mp_get_key_hashed( mp_t mp, const po_d key, ag_hash_t hash )
+{
+    return mp_lookup( mp, key, hash, 2 );
+}
+
+
+po_d mp_del_key_hashed( mp_t mp, const po_d key, ag_hash_t hash )
+{
+    return mp_delete( mp, key, hash, 2 );
 }
 
 
@@ -324,10 +760,11 @@ void mp_each( mp_t mp, mp_each_fn_p action, void* arg )
 {
     po_d key;
 
-    for ( po_size_t i = 0; i < po_size( mp->table ); i++ ) {
+    mp_incr_finish( mp, 1 );
+
+    for ( po_size_t i = mp_next_used( mp, 0, 1 ); i < po_size( mp->table ); i = mp_next_used( mp, i + 1, 1 ) ) {
         key = po_item( mp->table, i, po_d );
-        if ( key )
-            action( key, arg );
+        action( key, arg );
     }
 }
 
@@ -337,111 +774,3021 @@ void mp_each_key( mp_t mp, mp_each_key_fn_p action, void* arg )
     po_d key;
     po_d value;
 
-    for ( po_size_t i = 0; i < po_size( mp->table ); i += 2 ) {
-        key = po_item( mp->table, i, po_d );
-        if ( key ) {
-            value = po_item( mp->table, i + 1, po_d );
-            action( key, value, arg );
-        }
+    mp_incr_finish( mp, 2 );
+
+    for ( po_size_t i = mp_next_used( mp, 0, 2 ); i < mp_slot_cnt( mp, 2 ); i = mp_next_used( mp, i + 1, 2 ) ) {
+        key = po_item( mp->table, mp_key_pos( mp, i, 2 ), po_d );
+        value = po_item( mp->table, mp_value_pos( mp, i, 2 ), po_d );
+        action( key, value, arg );
     }
 }
 
 
 
-/* ------------------------------------------------------------
- * Internal support:
- */
+void mp_each_u64( mp_t mp, mp_each_u64_fn_p action, void* arg )
+{
+    for ( po_size_t i = mp_next_used( mp, 0, 2 ); i < mp_slot_cnt( mp, 2 ); i = mp_next_used( mp, i + 1, 2 ) ) {
+        action( po_item( mp->table, mp_key_pos( mp, i, 2 ), uintptr_t ), po_item( mp->table, mp_value_pos( mp, i, 2 ), po_d ), arg );
+    }
+}
 
 
-/**
- * Return next slot position.
- *
- * Wrap index according to given size.
- *
- * @param pos  Current position.
- * @param size Table size.
- *
- * @return Next position.
- */
-static po_size_t mp_next_pos( po_size_t pos, po_size_t size )
+void mp_iter_init( mp_t mp, mp_iter_s* it )
 {
-    return ( pos + 1 ) % size;
+    mp_incr_finish( mp, 1 );
+    it->mp = mp;
+    it->stride = 1;
+    it->pos = 0;
 }
 
 
-/**
- * Return next slot position for key/value table.
- *
- * Wrap index according to given size.
- *
- * @param pos  Current position.
- * @param size Table size.
- *
- * @return Next position.
- */
-static po_size_t mp_next_key_pos( po_size_t pos, po_size_t size )
+void mp_iter_init_key( mp_t mp, mp_iter_s* it )
 {
-    return ( pos + 2 ) % size;
+    mp_incr_finish( mp, 2 );
+    it->mp = mp;
+    it->stride = 2;
+    it->pos = 0;
 }
 
 
-/**
- * Rehash table.
- *
- * @param mp       Mapper.
- * @param new_size New size.
- */
-static void mp_rehash( mp_t mp, po_size_t new_size )
+int mp_iter_next( mp_iter_s* it, po_d* key, po_d* value )
 {
-    po_s old_table;
-
-    old_table = mp->table_desc;
-    mp->table = po_new_sized( &mp->table_desc, new_size );
-    mp->used_cnt = 0;
+    mp_t      mp = it->mp;
+    po_size_t cnt;
+    po_size_t pos;
 
-    po_d key;
-    for ( po_size_t i = 0; i < po_size( &old_table ); i++ ) {
-        key = po_item( &old_table, i, po_d );
-        if ( key ) {
-            mp_put( mp, key );
-        }
+    cnt = mp_slot_cnt( mp, it->stride );
+    pos = mp_next_used( mp, it->pos, it->stride );
+    if ( pos >= cnt ) {
+        it->pos = cnt;
+        return 0;
     }
 
-    if ( mp->rehash_cb ) {
-        mp->rehash_cb( mp, mp->rehash_env );
-    }
+    if ( key )
+        *key = po_item( mp->table, mp_key_pos( mp, pos, it->stride ), po_d );
+    if ( value )
+        *value = po_item( mp->table, mp_value_pos( mp, pos, it->stride ), po_d );
+    it->pos = pos + 1;
 
-    po_destroy_storage( &old_table );
+    return 1;
 }
 
 
-/**
- * Rehash key/value table.
- *
- * @param mp       Mapper.
- * @param new_size New size.
+#if MP_USE_THREADS == 1
+
+void mp_each_par( mp_t            mp,
+                  mp_each_fn_p    action,
+                  mp_combine_fn_p combine,
+                  void*           acc,
+                  po_size_t       acc_size,
+                  po_size_t       thr )
+{
+    mp_incr_finish( mp, 1 );
+    mp_each_run( mp, action, NULL, combine, acc, acc_size, thr, 1 );
+}
+
+
+void mp_each_key_par( mp_t             mp,
+                      mp_each_key_fn_p action,
+                      mp_combine_fn_p  combine,
+                      void*            acc,
+                      po_size_t        acc_size,
+                      po_size_t        thr )
+{
+    mp_incr_finish( mp, 2 );
+    mp_each_run( mp, NULL, action, combine, acc, acc_size, thr, 2 );
+}
+
+#endif
+
+
+#if MP_USE_STATS == 1
+
+void mp_stats( mp_t mp, mp_stats_s* st )
+{
+    mp_incr_finish( mp, 1 );
+    *st = mp->stats;
+    mp_stats_scan( mp, st, 1 );
+}
+
+
+void mp_stats_key( mp_t mp, mp_stats_s* st )
+{
+    mp_incr_finish( mp, 2 );
+    *st = mp->stats;
+    mp_stats_scan( mp, st, 2 );
+}
+
+
+void mp_stats_reset( mp_t mp )
+{
+    memset( &mp->stats, 0, sizeof( mp_stats_s ) );
+#if MP_USE_INCR == 1
+    if ( mp->old )
+        memset( &mp->old->stats, 0, sizeof( mp_stats_s ) );
+#endif
+}
+
+#endif
+
+
+
+/* ------------------------------------------------------------
+ * Internal support:
+ */
+
+
+/**
+ * Return number of slots (entries) in table.
+ *
+ * @param mp     Mapper.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Slot count.
+ */
+static po_size_t mp_slot_cnt( mp_t mp, po_size_t stride )
+{
+    return po_size( mp->table ) >> ( stride - 1 );
+}
+
+
+/**
+ * Return table position of key in slot.
+ *
+ * Keys and values are interleaved, or in separate halves of the table
+ * with MP_USE_SPLIT.
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Key position.
+ */
+static po_size_t mp_key_pos( mp_t mp, po_size_t slot, po_size_t stride )
+{
+#if MP_USE_SPLIT == 1
+    (void)mp;
+    (void)stride;
+    return slot;
+#else
+    (void)mp;
+    return slot * stride;
+#endif
+}
+
+
+/**
+ * Return table position of value in slot.
+ *
+ * In Object Mode the value is the key itself.
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Value position.
+ */
+static po_size_t mp_value_pos( mp_t mp, po_size_t slot, po_size_t stride )
+{
+#if MP_USE_SPLIT == 1
+    return slot + ( stride - 1 ) * mp_slot_cnt( mp, stride );
+#else
+    (void)mp;
+    return slot * stride + stride - 1;
+#endif
+}
+
+
+/**
+ * Wrap position according to given size.
+ *
+ * @param pos  Position.
+ * @param size Table size (in slots).
+ *
+ * @return Wrapped position.
+ */
+static po_size_t mp_wrap( po_size_t pos, po_size_t size )
+{
+#if MP_USE_POW2 == 1
+    return pos & ( size - 1 );
+#else
+    return pos % size;
+#endif
+}
+
+
+/**
+ * Return next slot position.
+ *
+ * Wrap index according to given size.
+ *
+ * @param pos  Current position.
+ * @param size Table size (in slots).
+ *
+ * @return Next position.
+ */
+static po_size_t mp_next_pos( po_size_t pos, po_size_t size )
+{
+    return mp_wrap( pos + 1, size );
+}
+
+
+/**
+ * Return home slot for hash.
+ *
+ * @param hash Key hash.
+ * @param cnt  Slot count.
+ *
+ * @return Home slot.
+ */
+static po_size_t mp_home( ag_hash_t hash, po_size_t cnt )
+{
+#if MP_USE_POW2 == 1
+    /* Fibonacci hashing: take the top bits of the product. */
+    return ( ( hash * MP_FIB_MULT ) >> ( 63 - __builtin_ctzll( cnt ) ) ) >> 1;
+#else
+    return hash % cnt;
+#endif
+}
+
+
+/**
+ * Return first slot visited for hash, e.g. for prefetching.
+ *
+ * This is the home slot, or with MP_USE_CUCKOO the first slot of the
+ * first bucket.
+ *
+ * @param mp     Mapper.
+ * @param hash   Key hash.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Slot.
+ */
+static po_size_t mp_home_slot( mp_t mp, ag_hash_t hash, po_size_t stride )
+{
+#if MP_USE_CUCKOO == 1
+    po_size_t bkt[ 2 ];
+    mp_cuckoo_buckets( mp, hash, stride, bkt );
+    return bkt[ 0 ] * mp_cuckoo_width( stride );
+#else
+    return mp_home( hash, mp_slot_cnt( mp, stride ) );
+#endif
+}
+
+
+#if MP_USE_TAGS == 1
+
+/**
+ * Return tag for hash.
+ *
+ * @param hash Key hash.
+ *
+ * @return Tag.
+ */
+static uint8_t mp_tag( ag_hash_t hash )
+{
+    return (uint8_t)( hash >> 57 );
+}
+
+
+/**
+ * Return bitmask of tags in group that match the given tag.
+ *
+ * @param group Start of tag group.
+ * @param tag   Tag to match.
+ *
+ * @return Match bitmask (bit 0 is the first tag).
+ */
+static uint32_t mp_tag_match( const uint8_t* group, uint8_t tag )
+{
+#if defined( __AVX2__ )
+    __m256i tags = _mm256_loadu_si256( (const __m256i*)group );
+    return (uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( tags, _mm256_set1_epi8( (char)tag ) ) );
+#elif defined( __SSE2__ )
+    __m128i tags = _mm_loadu_si128( (const __m128i*)group );
+    return (uint32_t)_mm_movemask_epi8( _mm_cmpeq_epi8( tags, _mm_set1_epi8( (char)tag ) ) );
+#else
+    uint32_t mask = 0;
+    for ( int i = 0; i < MP_TAG_GROUP; i++ ) {
+        if ( group[ i ] == tag )
+            mask |= ( 1u << i );
+    }
+    return mask;
+#endif
+}
+
+
+/**
+ * Set tag for slot.
+ *
+ * Tags for the first group of slots are mirrored after the last
+ * slot, so that a group can be loaded at any slot position.
+ *
+ * @param mp   Mapper.
+ * @param slot Slot.
+ * @param cnt  Slot count.
+ * @param tag  Tag.
+ */
+static void mp_tag_set( mp_t mp, po_size_t slot, po_size_t cnt, uint8_t tag )
+{
+    mp->tags[ slot ] = tag;
+    for ( po_size_t i = slot; i < MP_TAG_GROUP; i += cnt ) {
+        mp->tags[ cnt + i ] = tag;
+    }
+}
+
+#endif
+
+
+/**
+ * Return table size to use for requested size.
+ *
+ * With MP_USE_POW2 size is rounded up to power of two (at least 2),
+ * otherwise size is used as is. With MP_USE_CUCKOO size is first
+ * rounded up to whole buckets (at least two), and with MP_USE_SPLIT
+ * to whole buckets in both halves of Key Mode table.
+ *
+ * @param size Requested size.
+ *
+ * @return Table size.
+ */
+static po_size_t mp_size_fix( po_size_t size )
+{
+#if MP_USE_CUCKOO == 1
+    if ( size < 2 * MP_CUCKOO_UNIT )
+        size = 2 * MP_CUCKOO_UNIT;
+    size = ( ( size + MP_CUCKOO_UNIT - 1 ) / MP_CUCKOO_UNIT ) * MP_CUCKOO_UNIT;
+#endif
+#if MP_USE_POW2 == 1
+    po_size_t ret = 2;
+    while ( ret < size )
+        ret <<= 1;
+    return ret;
+#else
+    return size;
+#endif
+}
+
+
+/**
+ * Find slot for key.
+ *
+ * Return the slot with matching key or the first empty slot in the
+ * probe sequence. If table is full and key is not found, slot count
+ * is returned. With MP_USE_CUCKOO the two buckets of key and the
+ * stash are searched, and slot count is returned when both buckets
+ * are full.
+ *
+ * @param mp     Mapper.
+ * @param key    Key (or Object).
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ * @param found  Set to 1 if key was found, else 0.
+ *
+ * @return Slot (not table position).
+ */
+static po_size_t mp_find( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride, int* found )
+{
+    po_size_t cnt;
+    po_size_t slot;
+    po_d      item;
+
+    cnt = mp_slot_cnt( mp, stride );
+    slot = mp_home( hash, cnt );
+    MP_STAT( mp, lookups, 1 );
+
+#if MP_USE_TAGS == 1
+
+    po_size_t pos;
+    uint8_t   tag;
+    uint32_t  match;
+    uint32_t  empty;
+    uint32_t  lim;
+
+    tag = mp_tag( hash );
+
+    for ( po_size_t seen = 0; seen < cnt; seen += MP_TAG_GROUP ) {
+
+        MP_STAT( mp, probes, 1 );
+        match = mp_tag_match( &mp->tags[ slot ], tag );
+        empty = mp_tag_match( &mp->tags[ slot ], MP_TAG_EMPTY );
+
+        if ( cnt - seen < MP_TAG_GROUP ) {
+            lim = ( 1u << ( cnt - seen ) ) - 1;
+            match &= lim;
+            empty &= lim;
+        }
+
+        /* Only tags before the first empty slot are candidates. */
+        if ( empty )
+            match &= ( empty & -empty ) - 1;
+
+        while ( match ) {
+            pos = mp_wrap( slot + __builtin_ctz( match ), cnt );
+            item = po_item( mp->table, mp_key_pos( mp, pos, stride ), po_d );
+            if ( mp_match( mp, pos, item, key, hash ) ) {
+                MP_STAT( mp, hits, 1 );
+                *found = 1;
+                return pos;
+            }
+            match &= match - 1;
+        }
+
+        if ( empty ) {
+            MP_STAT( mp, misses, 1 );
+            *found = 0;
+            return mp_wrap( slot + __builtin_ctz( empty ), cnt );
+        }
+
+        slot = mp_wrap( slot + MP_TAG_GROUP, cnt );
+    }
+
+#elif MP_USE_CUCKOO == 1
+
+    po_size_t bkt[ 2 ];
+    po_size_t width;
+    po_size_t empty;
+
+    width = mp_cuckoo_width( stride );
+    mp_cuckoo_buckets( mp, hash, stride, bkt );
+    empty = cnt;
+
+    /* Entry is in one of its two buckets, in any slot. */
+    for ( int b = 0; b < 2 && ( b == 0 || bkt[ 1 ] != bkt[ 0 ] ); b++ ) {
+
+        MP_STAT( mp, probes, 1 );
+
+        for ( slot = bkt[ b ] * width; slot < ( bkt[ b ] + 1 ) * width; slot++ ) {
+            item = po_item( mp->table, mp_key_pos( mp, slot, stride ), po_d );
+            if ( item == NULL ) {
+                if ( empty == cnt )
+                    empty = slot;
+            } else if ( mp_match( mp, slot, item, key, hash ) ) {
+                MP_STAT( mp, hits, 1 );
+                *found = 1;
+                return slot;
+            }
+        }
+    }
+
+    /* Overflow entries (used stash slots are at its start). */
+    slot = mp_cuckoo_bkt_cnt( mp, stride ) * width;
+    for ( po_size_t i = 0; i < mp->stash_cnt; i++, slot++ ) {
+        MP_STAT( mp, probes, 1 );
+        item = po_item( mp->table, mp_key_pos( mp, slot, stride ), po_d );
+        if ( mp_match( mp, slot, item, key, hash ) ) {
+            MP_STAT( mp, hits, 1 );
+            *found = 1;
+            return slot;
+        }
+    }
+
+    MP_STAT( mp, misses, 1 );
+    *found = 0;
+    return empty;
+
+#else
+
+    for ( po_size_t seen = 0; seen < cnt; seen++ ) {
+
+        MP_STAT( mp, probes, 1 );
+        item = po_item( mp->table, mp_key_pos( mp, slot, stride ), po_d );
+
+        if ( item == NULL ) {
+            MP_STAT( mp, misses, 1 );
+            *found = 0;
+            return slot;
+        }
+
+#if MP_USE_MISS_CNT == 1
+        /* Resident is closer to its home than key would be, hence
+         * key is not in table (Robin Hood invariant). */
+        if ( mp_dist( mp, slot, stride ) < seen ) {
+            MP_STAT( mp, misses, 1 );
+            *found = 0;
+            return slot;
+        }
+#endif
+
+        if ( mp_match( mp, slot, item, key, hash ) ) {
+            MP_STAT( mp, hits, 1 );
+            *found = 1;
+            return slot;
+        }
+
+        slot = mp_next_pos( slot, cnt );
+    }
+
+#endif
+
+    MP_STAT( mp, misses, 1 );
+    *found = 0;
+    return cnt;
+}
+
+
+/**
+ * Check if resident of slot matches key.
+ *
+ * @param mp   Mapper.
+ * @param slot Slot.
+ * @param item Resident key (or Object).
+ * @param key  Key (or Object).
+ * @param hash Hash of key.
+ *
+ * @return 1 if match, else 0.
+ */
+static int mp_match( mp_t mp, po_size_t slot, const po_d item, const po_d key, ag_hash_t hash )
+{
+#if MP_USE_HASH == 1
+    if ( mp->hashes[ slot ] != hash )
+        return 0;
+#else
+    (void)slot;
+    (void)hash;
+#endif
+    MP_STAT( mp, comps, 1 );
+    return mp->key_comp( item, key );
+}
+
+
+#if MP_USE_MISS_CNT == 1
+
+/**
+ * Return probe distance of entry in slot.
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot (used).
+ * @param stride Slots per entry.
+ *
+ * @return Distance from home slot.
+ */
+static po_size_t mp_dist( mp_t mp, po_size_t slot, po_size_t stride )
+{
+    po_size_t cnt;
+
+    if ( mp->dist[ slot ] < MP_DIST_SAT )
+        return mp->dist[ slot ];
+
+    cnt = mp_slot_cnt( mp, stride );
+    return mp_wrap( slot + cnt - mp_home( mp_slot_hash( mp, slot, stride ), cnt ), cnt );
+}
+
+
+/**
+ * Set probe distance of entry in slot.
+ *
+ * @param mp   Mapper.
+ * @param slot Slot.
+ * @param dist Distance from home slot.
+ */
+static void mp_dist_set( mp_t mp, po_size_t slot, po_size_t dist )
+{
+    mp->dist[ slot ] = ( dist < MP_DIST_SAT ) ? dist : MP_DIST_SAT;
+}
+
+#endif
+
+
+#if MP_USE_CUCKOO == 1
+
+/**
+ * Return number of entries per bucket.
+ *
+ * Bucket is one cache line of keys. With MP_USE_SPLIT keys are
+ * contiguous, and a line holds MP_CUCKOO_LINE keys also in Key Mode
+ * (values are in the matching line of value half).
+ *
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Entries per bucket.
+ */
+static po_size_t mp_cuckoo_width( po_size_t stride )
+{
+#if MP_USE_SPLIT == 1
+    (void)stride;
+    return MP_CUCKOO_LINE;
+#else
+    return MP_CUCKOO_LINE / stride;
+#endif
+}
+
+
+/**
+ * Return number of hashed buckets.
+ *
+ * Table ends with the stash, i.e. one bucket per MP_CUCKOO_STASH
+ * buckets (at least one), where entries that do not fit to their
+ * buckets overflow.
+ *
+ * @param mp     Mapper.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Bucket count.
+ */
+static po_size_t mp_cuckoo_bkt_cnt( mp_t mp, po_size_t stride )
+{
+    po_size_t cnt;
+
+    cnt = mp_slot_cnt( mp, stride ) / mp_cuckoo_width( stride );
+    return cnt - ( cnt + MP_CUCKOO_STASH - 1 ) / MP_CUCKOO_STASH;
+}
+
+
+/**
+ * Return the two candidate buckets for hash.
+ *
+ * Buckets are selected by two multiplicative mixes of the hash, hence
+ * also low entropy hashes spread well. Bucket count does not need to
+ * be power of two, since the top bits of the mix are scaled to the
+ * bucket count. Second bucket differs from the first one if there
+ * are several buckets.
+ *
+ * @param mp     Mapper.
+ * @param hash   Key hash.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ * @param bkt    Buckets (result, 2 entries).
+ */
+static void mp_cuckoo_buckets( mp_t mp, ag_hash_t hash, po_size_t stride, po_size_t* bkt )
+{
+    po_size_t cnt;
+
+    cnt = mp_cuckoo_bkt_cnt( mp, stride );
+
+    bkt[ 0 ] = ( (unsigned __int128)( hash * MP_CUCKOO_MULT_1 ) * cnt ) >> 64;
+    bkt[ 1 ] = ( (unsigned __int128)( ( hash ^ ( hash >> 32 ) ) * MP_CUCKOO_MULT_2 ) * cnt ) >> 64;
+    if ( bkt[ 1 ] == bkt[ 0 ] )
+        bkt[ 1 ] = ( bkt[ 0 ] + 1 < cnt ) ? bkt[ 0 ] + 1 : 0;
+}
+
+
+/**
+ * Return alternate bucket for resident of slot.
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot (used).
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Bucket.
+ */
+static po_size_t mp_cuckoo_alt( mp_t mp, po_size_t slot, po_size_t stride )
+{
+    po_size_t bkt[ 2 ];
+
+    mp_cuckoo_buckets( mp, mp_slot_hash( mp, slot, stride ), stride, bkt );
+    if ( slot / mp_cuckoo_width( stride ) == bkt[ 0 ] )
+        return bkt[ 1 ];
+    else
+        return bkt[ 0 ];
+}
+
+
+/**
+ * Return free slot of bucket.
+ *
+ * @param mp     Mapper.
+ * @param bkt    Bucket.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Slot, or slot count if bucket is full.
+ */
+static po_size_t mp_cuckoo_free( mp_t mp, po_size_t bkt, po_size_t stride )
+{
+    po_size_t width;
+
+    width = mp_cuckoo_width( stride );
+    for ( po_size_t slot = bkt * width; slot < ( bkt + 1 ) * width; slot++ ) {
+        if ( po_item( mp->table, mp_key_pos( mp, slot, stride ), po_d ) == NULL )
+            return slot;
+    }
+
+    return mp_slot_cnt( mp, stride );
+}
+
+
+/**
+ * Displacement search node.
+ */
+typedef struct mp_cuckoo_node_s
+{
+    po_size_t slot;   /**< Slot of resident. */
+    po_size_t parent; /**< Node, whose resident moves to slot. */
+} mp_cuckoo_node_s;
+
+
+/**
+ * Make room for key with hash.
+ *
+ * Free slot of the two buckets is returned, if any. Otherwise
+ * residents are visited breadth-first, starting from the buckets of
+ * key. When a resident has room in its alternate bucket, the
+ * residents of the path are moved one step, starting from the last
+ * one, and the freed slot of key's bucket is returned. Hence the
+ * shortest path is used. If no path is found, the next stash slot is
+ * returned (e.g. for many keys with equal hash).
+ *
+ * @param mp     Mapper.
+ * @param hash   Key hash.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Free slot, or slot count if stash is full too.
+ */
+static po_size_t mp_cuckoo_room( mp_t mp, ag_hash_t hash, po_size_t stride )
+{
+    mp_cuckoo_node_s node[ MP_CUCKOO_SEARCH ];
+    po_size_t        bkt[ 2 ];
+    po_size_t        cnt;
+    po_size_t        width;
+    po_size_t        head;
+    po_size_t        tail;
+    po_size_t        alt;
+    po_size_t        dst;
+    po_size_t        p;
+
+    cnt = mp_slot_cnt( mp, stride );
+    width = mp_cuckoo_width( stride );
+    mp_cuckoo_buckets( mp, hash, stride, bkt );
+
+    tail = 0;
+    for ( int b = 0; b < 2 && ( b == 0 || bkt[ 1 ] != bkt[ 0 ] ); b++ ) {
+        dst = mp_cuckoo_free( mp, bkt[ b ], stride );
+        if ( dst != cnt )
+            return dst;
+        for ( po_size_t slot = bkt[ b ] * width; slot < ( bkt[ b ] + 1 ) * width; slot++ ) {
+            node[ tail ].slot = slot;
+            node[ tail ].parent = MP_CUCKOO_SEARCH;
+            tail++;
+        }
+    }
+
+    for ( head = 0; head < tail; head++ ) {
+
+        alt = mp_cuckoo_alt( mp, node[ head ].slot, stride );
+        dst = mp_cuckoo_free( mp, alt, stride );
+
+        if ( dst != cnt ) {
+            for ( p = head; p != MP_CUCKOO_SEARCH; p = node[ p ].parent ) {
+                mp_slot_move( mp, dst, node[ p ].slot, stride );
+                dst = node[ p ].slot;
+            }
+            MP_STAT( mp, probes, head + 1 );
+            return dst;
+        }
+
+        /* Slot can appear only once in a path. */
+        for ( po_size_t slot = alt * width; slot < ( alt + 1 ) * width && tail < MP_CUCKOO_SEARCH; slot++ ) {
+            for ( p = head; p != MP_CUCKOO_SEARCH && node[ p ].slot != slot; p = node[ p ].parent )
+                ;
+            if ( p == MP_CUCKOO_SEARCH ) {
+                node[ tail ].slot = slot;
+                node[ tail ].parent = head;
+                tail++;
+            }
+        }
+    }
+
+    MP_STAT( mp, probes, tail );
+
+    dst = mp_cuckoo_bkt_cnt( mp, stride ) * width + mp->stash_cnt;
+    if ( dst < cnt ) {
+        mp->stash_cnt++;
+        return dst;
+    }
+
+    return cnt;
+}
+
+
+/**
+ * Return slot for placing key.
+ *
+ * If slot is slot count (buckets are full), room is made by moving
+ * residents, or table is grown (see mp_grow()) until there is room.
+ * Entry count is not updated, and it must not include the entry.
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot from mp_find().
+ * @param hash   Key hash.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Free slot, or slot count if table can't grow.
+ */
+static po_size_t mp_cuckoo_slot( mp_t mp, po_size_t slot, ag_hash_t hash, po_size_t stride )
+{
+    po_size_t cnt;
+
+    cnt = mp_slot_cnt( mp, stride );
+    if ( slot != cnt )
+        return slot;
+
+    for ( ;; ) {
+        slot = mp_cuckoo_room( mp, hash, stride );
+        if ( slot != cnt )
+            return slot;
+
+        if ( mp_grow( mp, stride ) != 0 )
+            return cnt;
+        cnt = mp_slot_cnt( mp, stride );
+    }
+}
+
+#endif
+
+
+/**
+ * Place new entry to slot.
+ *
+ * Slot is the one returned by mp_find() for a missing key. With
+ * MP_USE_MISS_CNT the resident entry (if any) is displaced forward,
+ * as Robin Hood insertion requires. With MP_USE_CUCKOO slot must be
+ * free (see mp_cuckoo_slot()).
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ * @param key    Key (or Object).
+ * @param value  Value (Key Mode only).
+ * @param hash   Hash of key.
+ *
+ * @return 1 if table should grow (probe limit exceeded), else 0.
+ */
+static int mp_place( mp_t mp, po_size_t slot, po_size_t stride, const po_d key, const po_d value, ag_hash_t hash )
+{
+#if MP_USE_MISS_CNT == 1
+
+    po_size_t cnt;
+    po_size_t dist;
+    po_size_t max;
+    po_d      cur_key;
+    po_d      cur_value;
+    po_d      res_key;
+    po_d      res_value;
+    po_size_t res_dist;
+    ag_hash_t cur_hash;
+#if MP_USE_HASH == 1
+    ag_hash_t res_hash;
+#endif
+
+    cnt = mp_slot_cnt( mp, stride );
+    dist = mp_wrap( slot + cnt - mp_home( hash, cnt ), cnt );
+    max = dist;
+    cur_key = key;
+    cur_value = value;
+    cur_hash = hash;
+    res_value = NULL;
+
+    /* New entry lands on the given slot and the residents are
+     * displaced forward until an empty slot is reached. */
+    for ( ;; ) {
+
+        res_key = po_item( mp->table, mp_key_pos( mp, slot, stride ), po_d );
+        res_dist = ( res_key != NULL ) ? mp_dist( mp, slot, stride ) : 0;
+
+        if ( res_key == NULL || res_dist < dist ) {
+
+            po_assign( mp->table, mp_key_pos( mp, slot, stride ), cur_key );
+            if ( stride == 2 ) {
+                res_value = po_item( mp->table, mp_value_pos( mp, slot, stride ), po_d );
+                po_assign( mp->table, mp_value_pos( mp, slot, stride ), cur_value );
+            }
+            mp_dist_set( mp, slot, dist );
+
+#if MP_USE_HASH == 1
+            res_hash = mp->hashes[ slot ];
+#endif
+            mp_meta_set( mp, slot, stride, cur_hash );
+
+            if ( res_key == NULL )
+                break;
+
+            cur_key = res_key;
+            cur_value = res_value;
+#if MP_USE_HASH == 1
+            cur_hash = res_hash;
+#endif
+            dist = res_dist;
+        }
+
+        slot = mp_next_pos( slot, cnt );
+        dist++;
+        if ( dist > max )
+            max = dist;
+    }
+
+    /* Grow early only if table is reasonably filled, since a poor
+     * hash function would otherwise grow the table without limit. */
+    if ( max > mp->miss_cnt && ( mp->used_cnt * 100 ) / po_size( mp->table ) >= mp->fill_lim / 4 )
+#if MP_USE_INCR == 1
+        return ( mp->old == NULL );
+#else
+        return 1;
+#endif
+    else
+        return 0;
+
+#else
+
+    po_assign( mp->table, mp_key_pos( mp, slot, stride ), key );
+    if ( stride == 2 )
+        po_assign( mp->table, mp_value_pos( mp, slot, stride ), value );
+    mp_meta_set( mp, slot, stride, hash );
+    return 0;
+
+#endif
+}
+
+
+/**
+ * Insert entry, which is known to be missing from table.
+ *
+ * Key compare is not needed, since only the insertion slot is
+ * searched. With MP_USE_CUCKOO table is not grown, and entry is not
+ * inserted if there is no room for it.
+ *
+ * @param mp     Mapper.
+ * @param key    Key (or Object).
+ * @param value  Value (Key Mode only).
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return 1 if table should grow (probe limit exceeded or no room),
+ *         else 0.
+ */
+static int mp_insert_new( mp_t mp, const po_d key, const po_d value, ag_hash_t hash, po_size_t stride )
+{
+#if MP_USE_CUCKOO == 1
+
+    po_size_t slot;
+
+    slot = mp_cuckoo_room( mp, hash, stride );
+    if ( slot == mp_slot_cnt( mp, stride ) )
+        return 1;
+
+    return mp_place( mp, slot, stride, key, value, hash );
+
+#else
+
+    po_size_t cnt;
+    po_size_t slot;
+
+    cnt = mp_slot_cnt( mp, stride );
+    slot = mp_home( hash, cnt );
+
+    for ( po_size_t dist = 0; po_item( mp->table, mp_key_pos( mp, slot, stride ), po_d ) != NULL; dist++ ) {
+#if MP_USE_MISS_CNT == 1
+        if ( mp_dist( mp, slot, stride ) < dist )
+            break;
+#endif
+        slot = mp_next_pos( slot, cnt );
+    }
+
+    return mp_place( mp, slot, stride, key, value, hash );
+
+#endif
+}
+
+
+/**
+ * Remove entry from slot.
+ *
+ * Following entries of the probe chain are shifted backwards to fill
+ * the hole (backward-shift deletion), hence no tombstones are needed
+ * and all remaining entries stay reachable from their home slots.
+ * With MP_USE_CUCKOO there are no probe chains, and the slot is only
+ * cleared (or refilled from the end of the stash).
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot of entry.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_remove( mp_t mp, po_size_t slot, po_size_t stride )
+{
+    po_size_t cnt;
+    po_size_t hole;
+    po_d      item;
+
+    cnt = mp_slot_cnt( mp, stride );
+    hole = slot;
+
+    po_assign( mp->table, mp_key_pos( mp, hole, stride ), NULL );
+    if ( stride == 2 )
+        po_assign( mp->table, mp_value_pos( mp, hole, stride ), NULL );
+    mp_meta_clear( mp, hole, stride );
+
+#if MP_USE_CUCKOO == 1
+
+    /* Stash is kept compact by moving its last entry to the hole. */
+    po_size_t stash;
+    stash = mp_cuckoo_bkt_cnt( mp, stride ) * mp_cuckoo_width( stride );
+    if ( hole >= stash ) {
+        mp->stash_cnt--;
+        if ( hole != stash + mp->stash_cnt )
+            mp_slot_move( mp, hole, stash + mp->stash_cnt, stride );
+    }
+    (void)cnt;
+    (void)item;
+
+#else
+
+    for ( po_size_t pos = mp_next_pos( hole, cnt );; pos = mp_next_pos( pos, cnt ) ) {
+
+        item = po_item( mp->table, mp_key_pos( mp, pos, stride ), po_d );
+        if ( item == NULL )
+            break;
+
+#if MP_USE_MISS_CNT == 1
+
+        /* Robin Hood: shift back until an entry is at its home. */
+        po_size_t dist;
+        dist = mp_dist( mp, pos, stride );
+        if ( dist == 0 )
+            break;
+
+        mp_slot_move( mp, hole, pos, stride );
+        mp_dist_set( mp, hole, dist - 1 );
+        hole = pos;
+
+#else
+
+        /* Entry can fill the hole if its home is not between hole and
+         * entry (cyclically). */
+        po_size_t home;
+        home = mp_home( mp_slot_hash( mp, pos, stride ), cnt );
+        if ( mp_wrap( pos + cnt - home, cnt ) >= mp_wrap( pos + cnt - hole, cnt ) ) {
+            mp_slot_move( mp, hole, pos, stride );
+            hole = pos;
+        }
+
+#endif
+    }
+
+#endif
+}
+
+
+/**
+ * Move entry from slot to another (free) slot.
+ *
+ * @param mp     Mapper.
+ * @param dst    Destination slot.
+ * @param src    Source slot.
+ * @param stride Slots per entry.
+ */
+static void mp_slot_move( mp_t mp, po_size_t dst, po_size_t src, po_size_t stride )
+{
+    po_assign( mp->table, mp_key_pos( mp, dst, stride ), po_item( mp->table, mp_key_pos( mp, src, stride ), po_d ) );
+    po_assign( mp->table, mp_key_pos( mp, src, stride ), NULL );
+    if ( stride == 2 ) {
+        po_assign( mp->table, mp_value_pos( mp, dst, stride ), po_item( mp->table, mp_value_pos( mp, src, stride ), po_d ) );
+        po_assign( mp->table, mp_value_pos( mp, src, stride ), NULL );
+    }
+    mp_meta_move( mp, dst, src, stride );
+}
+
+
+/**
+ * Return hash of key in slot.
+ *
+ * With MP_USE_HASH the stored hash is used, otherwise the hash is
+ * computed.
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot (used).
+ * @param stride Slots per entry.
+ *
+ * @return Hash of key.
+ */
+static ag_hash_t mp_slot_hash( mp_t mp, po_size_t slot, po_size_t stride )
+{
+#if MP_USE_HASH == 1
+    (void)stride;
+    return mp->hashes[ slot ];
+#else
+    return mp->key_hash( po_item( mp->table, mp_key_pos( mp, slot, stride ), po_d ) );
+#endif
+}
+
+
+#if MP_USE_CUCKOO == 1
+
+/**
+ * Allocate bucket aligned heap storage (default cuckoo allocator).
+ *
+ * @param env  Unused.
+ * @param size Size in bytes.
+ *
+ * @return Storage or NULL.
+ */
+static void* mp_heap_alloc( void* env, po_size_t size )
+{
+    void* ptr;
+
+    (void)env;
+    if ( posix_memalign( &ptr, MP_CUCKOO_ALIGN, size ) != 0 )
+        return NULL;
+    return ptr;
+}
+
+
+/**
+ * Free heap storage.
+ *
+ * @param env  Unused.
+ * @param ptr  Storage.
+ * @param size Size in bytes.
+ */
+static void mp_heap_free( void* env, void* ptr, po_size_t size )
+{
+    (void)env;
+    (void)size;
+    free( ptr );
+}
+
+
+/** Default allocator for cuckoo tables. */
+static mp_alloc_s mp_heap_aligned = { mp_heap_alloc, mp_heap_free, NULL };
+
+#endif
+
+
+/**
+ * Allocate table storage (cleared) for Mapper.
+ *
+ * With MP_USE_CUCKOO heap storage is aligned to buckets, hence
+ * default allocator is used instead of Postor. Previous table (e.g.
+ * from mp_use()) is freed with the allocator of its copy.
+ *
+ * @param mp   Mapper.
+ * @param size Table size (slots).
+ *
+ * @return Table descriptor (Mapper's own), or NULL if storage can't be
+ *         allocated.
+ */
+static po_t mp_table_new( mp_t mp, po_size_t size )
+{
+    po_d* data;
+
+#if MP_USE_CUCKOO == 1
+    if ( mp->alloc == NULL )
+        mp->alloc = &mp_heap_aligned;
+#endif
+
+    if ( mp->alloc == NULL ) {
+        po_new_sized( &mp->table_desc, size );
+        return ( po_data( &mp->table_desc ) != NULL ) ? &mp->table_desc : NULL;
+    }
+
+    data = mp->alloc->alloc( mp->alloc->env, size * sizeof( po_d ) );
+    if ( data == NULL )
+        return NULL;
+    memset( data, 0, size * sizeof( po_d ) );
+
+    return po_use( &mp->table_desc, data, size );
+}
+
+
+/**
+ * Free table storage.
+ *
+ * @param mp    Mapper (owner of table).
+ * @param table Table descriptor.
+ */
+static void mp_table_destroy( mp_t mp, po_t table )
+{
+    if ( mp->alloc == NULL )
+        po_destroy_storage( table );
+    else
+        mp->alloc->free( mp->alloc->env, po_data( table ), po_size( table ) * sizeof( po_d ) );
+}
+
+
+/**
+ * Allocate slot metadata for current table.
+ *
+ * @param mp Mapper.
+ */
+static void mp_meta_new( mp_t mp )
+{
+#if MP_USE_TAGS == 1
+    mp->tags = po_malloc( po_size( mp->table ) + MP_TAG_GROUP );
+    memset( mp->tags, MP_TAG_EMPTY, po_size( mp->table ) + MP_TAG_GROUP );
+#endif
+#if MP_USE_MISS_CNT == 1
+    mp->dist = po_malloc( po_size( mp->table ) );
+    memset( mp->dist, 0, po_size( mp->table ) );
+#endif
+#if MP_USE_HASH == 1
+    mp->hashes = po_malloc( po_size( mp->table ) * sizeof( ag_hash_t ) );
+#endif
+#if MP_USE_BITMAP == 1
+    /* Bitmap of previous table belongs to its copy (rehash). */
+    mp->occ = NULL;
+    mp_occ_new( mp );
+#endif
+#if MP_USE_CUCKOO == 1
+    mp->stash_cnt = 0;
+#endif
+    (void)mp;
+}
+
+
+/**
+ * Free slot metadata.
+ *
+ * @param mp Mapper.
+ */
+static void mp_meta_destroy( mp_t mp )
+{
+#if MP_USE_TAGS == 1
+    po_free( mp->tags );
+    mp->tags = NULL;
+#endif
+#if MP_USE_MISS_CNT == 1
+    po_free( mp->dist );
+    mp->dist = NULL;
+#endif
+#if MP_USE_HASH == 1
+    po_free( mp->hashes );
+    mp->hashes = NULL;
+#endif
+#if MP_USE_BITMAP == 1
+    mp_occ_destroy( mp );
+#endif
+    (void)mp;
+}
+
+
+/**
+ * Update slot metadata for a newly used slot.
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot.
+ * @param stride Slots per entry.
+ * @param hash   Hash of key in slot.
+ */
+static void mp_meta_set( mp_t mp, po_size_t slot, po_size_t stride, ag_hash_t hash )
+{
+#if MP_USE_TAGS == 1
+    mp_tag_set( mp, slot, mp_slot_cnt( mp, stride ), mp_tag( hash ) );
+#endif
+#if MP_USE_HASH == 1
+    mp->hashes[ slot ] = hash;
+#endif
+#if MP_USE_BITMAP == 1
+#if MP_USE_THREADS == 1
+    /* Rehash threads may set bits of the same word. */
+    __atomic_fetch_or( &mp->occ[ slot >> 6 ], 1ULL << ( slot & 63 ), __ATOMIC_RELAXED );
+#else
+    mp_occ_set( mp, slot );
+#endif
+#endif
+    (void)mp;
+    (void)slot;
+    (void)stride;
+    (void)hash;
+}
+
+
+/**
+ * Update slot metadata for a freed slot.
+ *
+ * @param mp     Mapper.
+ * @param slot   Slot.
+ * @param stride Slots per entry.
+ */
+static void mp_meta_clear( mp_t mp, po_size_t slot, po_size_t stride )
+{
+#if MP_USE_TAGS == 1
+    mp_tag_set( mp, slot, mp_slot_cnt( mp, stride ), MP_TAG_EMPTY );
+#endif
+#if MP_USE_BITMAP == 1
+    mp_occ_clear( mp, slot );
+#endif
+    (void)mp;
+    (void)slot;
+    (void)stride;
+}
+
+
+/**
+ * Move slot metadata from slot to another (free) slot.
+ *
+ * @param mp     Mapper.
+ * @param dst    Destination slot.
+ * @param src    Source slot.
+ * @param stride Slots per entry.
+ */
+static void mp_meta_move( mp_t mp, po_size_t dst, po_size_t src, po_size_t stride )
+{
+#if MP_USE_TAGS == 1
+    mp_tag_set( mp, dst, mp_slot_cnt( mp, stride ), mp->tags[ src ] );
+    mp_tag_set( mp, src, mp_slot_cnt( mp, stride ), MP_TAG_EMPTY );
+#endif
+#if MP_USE_HASH == 1
+    mp->hashes[ dst ] = mp->hashes[ src ];
+#endif
+#if MP_USE_BITMAP == 1
+    mp_occ_set( mp, dst );
+    mp_occ_clear( mp, src );
+#endif
+    (void)mp;
+    (void)dst;
+    (void)src;
+    (void)stride;
+}
+
+
+/**
+ * Insert or update entry.
+ *
+ * @param mp     Mapper.
+ * @param key    Key (or Object).
+ * @param value  Value (Key Mode only).
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Slot of entry, or MP_NO_INDEX if table is full and can't
+ *         grow.
+ */
+static po_size_t mp_insert( mp_t mp, const po_d key, const po_d value, ag_hash_t hash, po_size_t stride )
+{
+    po_size_t pos;
+    int       inserted;
+
+    pos = mp_upsert( mp, key, hash, stride, &inserted );
+    if ( pos == mp_slot_cnt( mp, stride ) )
+        return MP_NO_INDEX;
+    po_assign( mp->table, mp_key_pos( mp, pos, stride ), key );
+    if ( stride == 2 )
+        po_assign( mp->table, mp_value_pos( mp, pos, stride ), value );
+
+    return pos;
+}
+
+
+/**
+ * Find entry, or insert key (with NULL value) if missing.
+ *
+ * Table is grown before the probe, and key compare is done once
+ * for the single probe (except when probe limit forces
+ * growth after placement).
+ *
+ * @param mp       Mapper.
+ * @param key      Key (or Object).
+ * @param hash     Hash of key.
+ * @param stride   Slots per entry (1: Object Mode, 2: Key Mode).
+ * @param inserted Set to 1 if key was inserted, else 0.
+ *
+ * @return Slot of entry, or slot count if table is full and can't
+ *         grow.
+ */
+static po_size_t mp_upsert( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride, int* inserted )
+{
+    po_size_t pos;
+    int       found;
+
+    mp_incr_step( mp, stride );
+
+    if ( ( ( mp->used_cnt * 100 ) / po_size( mp->table ) ) >= mp->fill_lim ) {
+        mp_grow( mp, stride );
+    }
+
+    pos = mp_find_cur( mp, key, hash, stride, &found );
+    *inserted = !found;
+    if ( found )
+        return pos;
+
+#if MP_USE_CUCKOO == 1
+    /* Slot is needed for return. */
+    pos = mp_cuckoo_slot( mp, pos, hash, stride );
+#endif
+
+    /* With MP_USE_MISS_CNT a full table gives an occupied slot. */
+    if ( pos == mp_slot_cnt( mp, stride ) || mp->used_cnt == po_size( mp->table ) ) {
+        /* Table is kept, if it can't grow. */
+        *inserted = 0;
+        return mp_slot_cnt( mp, stride );
+    }
+
+    mp->used_cnt += stride;
+    if ( mp_place( mp, pos, stride, key, NULL, hash ) ) {
+        /* Probe limit was exceeded, grow early. */
+        mp_grow( mp, stride );
+        pos = mp_find_cur( mp, key, hash, stride, &found );
+    }
+
+    return pos;
+}
+
+
+/**
+ * Lookup entry.
+ *
+ * @param mp     Mapper.
+ * @param key    Key (or Object).
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Object (Object Mode), value (Key Mode) or NULL.
+ */
+static po_d mp_lookup( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride )
+{
+    po_size_t pos;
+    int       found;
+
+    mp_incr_step( mp, stride );
+
+    pos = mp_find( mp, key, hash, stride, &found );
+    if ( found )
+        return po_item( mp->table, mp_value_pos( mp, pos, stride ), po_d );
+
+#if MP_USE_INCR == 1
+    if ( mp->old ) {
+        pos = mp_find( mp->old, key, hash, stride, &found );
+        if ( found )
+            return po_item( mp->old->table, mp_value_pos( mp->old, pos, stride ), po_d );
+    }
+#endif
+
+    return NULL;
+}
+
+
+/**
+ * Prefetch home slots of group of keys (and alternate buckets with
+ * MP_USE_CUCKOO), and then the resident objects of home slots (for
+ * key compare).
+ *
+ * @param mp     Mapper.
+ * @param hash   Key hashes.
+ * @param grp    Number of keys (at most MP_BATCH_SIZE).
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_batch_prefetch( mp_t mp, const ag_hash_t* hash, po_size_t grp, po_size_t stride )
+{
+    po_size_t home[ MP_BATCH_SIZE ];
+    po_d*     data;
+    po_d      item;
+#if MP_USE_CUCKOO == 1
+    po_size_t bkt[ 2 ];
+#endif
+
+    data = po_data( mp->table );
+
+    for ( po_size_t i = 0; i < grp; i++ ) {
+        home[ i ] = mp_home_slot( mp, hash[ i ], stride );
+        __builtin_prefetch( &data[ mp_key_pos( mp, home[ i ], stride ) ] );
+#if MP_USE_TAGS == 1
+        __builtin_prefetch( &mp->tags[ home[ i ] ] );
+#endif
+#if MP_USE_CUCKOO == 1
+        mp_cuckoo_buckets( mp, hash[ i ], stride, bkt );
+        __builtin_prefetch( &data[ mp_key_pos( mp, bkt[ 1 ] * mp_cuckoo_width( stride ), stride ) ] );
+#endif
+    }
+
+    for ( po_size_t i = 0; i < grp; i++ ) {
+        item = data[ mp_key_pos( mp, home[ i ], stride ) ];
+        if ( item )
+            __builtin_prefetch( item );
+    }
+}
+
+
+/**
+ * Lookup multiple entries.
+ *
+ * Keys are processed in groups. First all keys of group are hashed
+ * and their home slots are prefetched, then the resident objects of
+ * home slots are prefetched (for key compare), and finally the probes
+ * are resolved. Hence the cache misses of the group overlap.
+ *
+ * @param mp     Mapper.
+ * @param keys   Keys (or Objects).
+ * @param result Objects (Object Mode), values (Key Mode) or NULLs.
+ * @param cnt    Number of keys.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Number of keys found.
+ */
+static po_size_t mp_lookup_batch( mp_t mp, const po_d* keys, po_d* result, po_size_t cnt, po_size_t stride )
+{
+    ag_hash_t hash[ MP_BATCH_SIZE ];
+    po_size_t grp;
+    po_size_t pos;
+    po_size_t hits;
+    po_d*     data;
+    int       found;
+
+    mp_incr_step( mp, stride );
+
+    data = po_data( mp->table );
+    hits = 0;
+
+    for ( po_size_t base = 0; base < cnt; base += MP_BATCH_SIZE ) {
+
+        grp = ( cnt - base < MP_BATCH_SIZE ) ? cnt - base : MP_BATCH_SIZE;
+
+        for ( po_size_t i = 0; i < grp; i++ ) {
+            hash[ i ] = mp->key_hash( keys[ base + i ] );
+        }
+        mp_batch_prefetch( mp, hash, grp, stride );
+
+        for ( po_size_t i = 0; i < grp; i++ ) {
+
+            pos = mp_find( mp, keys[ base + i ], hash[ i ], stride, &found );
+            if ( found ) {
+                result[ base + i ] = data[ mp_value_pos( mp, pos, stride ) ];
+                hits++;
+                continue;
+            }
+
+            result[ base + i ] = NULL;
+
+#if MP_USE_INCR == 1
+            if ( mp->old ) {
+                pos = mp_find( mp->old, keys[ base + i ], hash[ i ], stride, &found );
+                if ( found ) {
+                    result[ base + i ] = po_item( mp->old->table, mp_value_pos( mp->old, pos, stride ), po_d );
+                    hits++;
+                }
+            }
+#endif
+        }
+    }
+
+    return hits;
+}
+
+
+/**
+ * Set operation between Mappers.
+ *
+ * Intersection and counts iterate the smaller Mapper and look up the
+ * larger one. Union puts "a" and then the entries of "b" missing from
+ * "a". Difference iterates "a". Destination is reserved for the
+ * largest possible result before entries are put.
+ *
+ * @param dst    Destination (NULL: count only).
+ * @param a      Mapper a.
+ * @param b      Mapper b.
+ * @param op     Operation (MP_SET_*).
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Number of entries in result.
+ */
+static po_size_t mp_set_op( mp_t dst, mp_t a, mp_t b, int op, po_size_t stride )
+{
+    po_size_t a_cnt;
+    po_size_t b_cnt;
+    po_size_t both;
+    int       a_small;
+
+    mp_incr_finish( a, stride );
+    mp_incr_finish( b, stride );
+
+    a_cnt = a->used_cnt / stride;
+    b_cnt = b->used_cnt / stride;
+    a_small = ( a_cnt <= b_cnt );
+
+    if ( dst == NULL ) {
+        if ( a_small )
+            both = mp_set_scan( NULL, a, b, 1, 1, stride );
+        else
+            both = mp_set_scan( NULL, b, a, 1, 0, stride );
+
+        switch ( op ) {
+            case MP_SET_UNION: return a_cnt + b_cnt - both;
+            case MP_SET_INTERSECT: return both;
+            default: return a_cnt - both;
+        }
+    }
+
+    switch ( op ) {
+
+        case MP_SET_UNION:
+            mp_reserve_slots( dst, dst->used_cnt / stride + a_cnt + b_cnt, stride );
+            both = mp_set_scan( dst, a, NULL, 1, 1, stride );
+            return both + mp_set_scan( dst, b, a, 0, 1, stride );
+
+        case MP_SET_INTERSECT:
+            mp_reserve_slots( dst, dst->used_cnt / stride + ( a_small ? a_cnt : b_cnt ), stride );
+            if ( a_small )
+                return mp_set_scan( dst, a, b, 1, 1, stride );
+            else
+                return mp_set_scan( dst, b, a, 1, 0, stride );
+
+        default:
+            mp_reserve_slots( dst, dst->used_cnt / stride + a_cnt, stride );
+            return mp_set_scan( dst, a, b, 0, 1, stride );
+    }
+}
+
+
+/**
+ * Iterate "src" and select entries by presence in "other".
+ *
+ * Keys of "src" are looked up from "other" in groups (see
+ * mp_batch_prefetch()). Selected entries are put to "dst". Key hashes
+ * are taken from "src" slots (stored with MP_USE_HASH), and they are
+ * used for both "other" and "dst", hence each key is hashed at most
+ * once.
+ *
+ * @param dst       Destination (NULL: count only).
+ * @param src       Iterated Mapper.
+ * @param other     Lookup Mapper (NULL: select all).
+ * @param want      Select entries found (1) or not found (0).
+ * @param src_value Values from "src" (else from "other").
+ * @param stride    Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Number of selected entries.
+ */
+static po_size_t mp_set_scan( mp_t dst, mp_t src, mp_t other, int want, int src_value, po_size_t stride )
+{
+    po_d      keys[ MP_BATCH_SIZE ];
+    po_size_t slot[ MP_BATCH_SIZE ];
+    ag_hash_t hash[ MP_BATCH_SIZE ];
+    po_size_t pos;
+    po_size_t hit;
+    po_size_t grp;
+    po_size_t sel;
+    po_size_t cnt;
+    po_d      value;
+    int       found;
+
+    cnt = mp_slot_cnt( src, stride );
+    sel = 0;
+
+    pos = mp_next_used( src, 0, stride );
+    while ( pos < cnt ) {
+
+        for ( grp = 0; grp < MP_BATCH_SIZE && pos < cnt; grp++ ) {
+            slot[ grp ] = pos;
+            keys[ grp ] = po_item( src->table, mp_key_pos( src, pos, stride ), po_d );
+            hash[ grp ] = mp_slot_hash( src, pos, stride );
+            pos = mp_next_used( src, pos + 1, stride );
+        }
+
+        if ( other )
+            mp_batch_prefetch( other, hash, grp, stride );
+
+        for ( po_size_t i = 0; i < grp; i++ ) {
+
+            value = NULL;
+
+            if ( other ) {
+                hit = mp_find( other, keys[ i ], hash[ i ], stride, &found );
+                if ( found != want )
+                    continue;
+                if ( found && !src_value && stride == 2 )
+                    value = po_item( other->table, mp_value_pos( other, hit, stride ), po_d );
+            }
+
+            sel++;
+
+            if ( dst ) {
+                if ( ( src_value || !other ) && stride == 2 )
+                    value = po_item( src->table, mp_value_pos( src, slot[ i ], stride ), po_d );
+                mp_insert( dst, keys[ i ], value, hash[ i ], stride );
+            }
+        }
+    }
+
+    return sel;
+}
+
+
+/**
+ * Resize table for entries, if needed.
+ *
+ * @param mp     Mapper.
+ * @param cnt    Number of entries.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_reserve_slots( mp_t mp, po_size_t cnt, po_size_t stride )
+{
+    po_size_t size;
+
+    mp_incr_finish( mp, stride );
+
+    size = mp_fit_size( mp, cnt, stride );
+    if ( size > po_size( mp->table ) )
+        mp_resize( mp, size, stride );
+}
+
+
+/**
+ * Return the smallest table size for entries under fill limit.
+ *
+ * @param mp     Mapper.
+ * @param cnt    Number of entries.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Table size (at least MP_MIN_SIZE).
+ */
+static po_size_t mp_fit_size( mp_t mp, po_size_t cnt, po_size_t stride )
+{
+    po_size_t size;
+
+    /* Fill limit is checked before put, hence the last entry must
+     * fit below the limit. */
+    size = ( cnt * stride * 100 ) / mp->fill_lim + stride;
+    if ( size < MP_MIN_SIZE )
+        size = MP_MIN_SIZE;
+
+    return mp_size_fix( ( ( size + stride - 1 ) / stride ) * stride );
+}
+
+
+/**
+ * Resize table at once (if size changes).
+ *
+ * @param mp       Mapper.
+ * @param new_size New size.
+ * @param stride   Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_resize( mp_t mp, po_size_t new_size, po_size_t stride )
+{
+    if ( new_size == po_size( mp->table ) )
+        return;
+
+    if ( mp->key_hash == NULL )
+        mp_rehash_u64( mp, new_size );
+    else
+        mp_rehash( mp, new_size, stride );
+}
+
+
+/**
+ * Halve table if fill level is below shrink limit.
+ *
+ * Shrink is skipped during incremental rehash.
+ *
+ * @param mp     Mapper.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_shrink_check( mp_t mp, po_size_t stride )
+{
+    po_size_t size;
+
+    if ( mp->shrink_lim == 0 )
+        return;
+
+#if MP_USE_INCR == 1
+    if ( mp->old )
+        return;
+#endif
+
+    size = po_size( mp->table );
+    if ( size / 2 < MP_MIN_SIZE || ( ( mp->used_cnt * 100 ) / size ) >= mp->shrink_lim )
+        return;
+
+    size = mp_size_fix( ( size / ( 2 * stride ) ) * stride );
+
+#if MP_USE_INCR == 1
+    if ( mp->key_hash != NULL ) {
+        mp_incr_start( mp, size, stride );
+        return;
+    }
+#endif
+
+    mp_resize( mp, size, stride );
+}
+
+
+/**
+ * Bulk insert entry.
+ */
+typedef struct mp_bulk_s
+{
+    po_size_t home; /**< Home slot bucket. */
+    po_size_t idx;  /**< Input index. */
+    ag_hash_t hash; /**< Key hash. */
+} mp_bulk_s;
+
+
+/**
+ * Insert multiple entries.
+ *
+ * @param mp     Mapper.
+ * @param keys   Keys (or Objects).
+ * @param values Values (Key Mode only).
+ * @param cnt    Number of entries.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_insert_bulk( mp_t mp, const po_d* keys, const po_d* values, po_size_t cnt, po_size_t stride )
+{
+    mp_bulk_s* in;
+    mp_bulk_s* ent;
+    po_size_t* start;
+    po_size_t  slots;
+    po_size_t  width;
+    po_size_t  bkt_cnt;
+
+    if ( cnt == 0 )
+        return;
+
+    mp_reserve_slots( mp, mp->used_cnt / stride + cnt, stride );
+
+    /* Entries are distributed to buckets of a few home slots
+     * (counting sort). In bucket order the probes proceed through
+     * the table front to back, and neighbouring entries share cache
+     * lines. Bucket keeps input order, hence later duplicates replace
+     * earlier. */
+    slots = mp_slot_cnt( mp, stride );
+    width = ( slots + cnt - 1 ) / cnt;
+    bkt_cnt = ( slots + width - 1 ) / width;
+
+    in = po_malloc( cnt * sizeof( mp_bulk_s ) );
+    ent = po_malloc( cnt * sizeof( mp_bulk_s ) );
+    start = po_malloc( ( bkt_cnt + 1 ) * sizeof( po_size_t ) );
+    memset( start, 0, ( bkt_cnt + 1 ) * sizeof( po_size_t ) );
+
+    for ( po_size_t i = 0; i < cnt; i++ ) {
+        in[ i ].hash = mp->key_hash( keys[ i ] );
+        in[ i ].home = mp_home_slot( mp, in[ i ].hash, stride ) / width;
+        in[ i ].idx = i;
+        start[ in[ i ].home + 1 ]++;
+    }
+
+    for ( po_size_t i = 1; i <= bkt_cnt; i++ ) {
+        start[ i ] += start[ i - 1 ];
+    }
+
+    for ( po_size_t i = 0; i < cnt; i++ ) {
+        ent[ start[ in[ i ].home ]++ ] = in[ i ];
+    }
+
+    po_free( start );
+    po_free( in );
+
+    for ( po_size_t i = 0; i < cnt; i++ ) {
+        mp_insert_hashed( mp,
+                          keys[ ent[ i ].idx ],
+                          ( stride == 2 ) ? values[ ent[ i ].idx ] : NULL,
+                          ent[ i ].hash,
+                          stride );
+    }
+
+    po_free( ent );
+}
+
+
+/**
+ * Insert multiple entries in order (pipelined).
+ *
+ * Entry is hashed and its home slot prefetched MP_BATCH_SIZE entries
+ * before it is placed. Halfway, the resident object of the home slot
+ * is prefetched (for key compare).
+ *
+ * @param mp     Mapper.
+ * @param keys   Keys (or Objects).
+ * @param values Values (Key Mode only).
+ * @param cnt    Number of entries.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_insert_batch( mp_t mp, const po_d* keys, const po_d* values, po_size_t cnt, po_size_t stride )
+{
+    ag_hash_t hash[ MP_BATCH_SIZE ];
+    po_size_t j;
+    po_d*     data;
+    po_d      item;
+#if MP_USE_CUCKOO == 1
+    po_size_t bkt[ 2 ];
+#endif
+
+    if ( cnt == 0 )
+        return;
+
+    mp_reserve_slots( mp, mp->used_cnt / stride + cnt, stride );
+
+    for ( po_size_t i = 0; i < cnt + MP_BATCH_SIZE; i++ ) {
+
+        /* Place entry, whose hash slot is then reused. */
+        if ( i >= MP_BATCH_SIZE ) {
+            j = i - MP_BATCH_SIZE;
+            mp_insert_hashed( mp, keys[ j ], ( stride == 2 ) ? values[ j ] : NULL, hash[ j % MP_BATCH_SIZE ], stride );
+        }
+
+        /* Table changes, if Robin Hood or cuckoo placement grows
+         * it. */
+        data = po_data( mp->table );
+
+        if ( i >= MP_BATCH_SIZE / 2 && i - MP_BATCH_SIZE / 2 < cnt ) {
+            j = i - MP_BATCH_SIZE / 2;
+            item = data[ mp_key_pos( mp, mp_home_slot( mp, hash[ j % MP_BATCH_SIZE ], stride ), stride ) ];
+            if ( item )
+                __builtin_prefetch( item );
+        }
+
+        if ( i < cnt ) {
+            hash[ i % MP_BATCH_SIZE ] = mp->key_hash( keys[ i ] );
+            j = mp_home_slot( mp, hash[ i % MP_BATCH_SIZE ], stride );
+            __builtin_prefetch( &data[ mp_key_pos( mp, j, stride ) ], 1 );
+#if MP_USE_TAGS == 1
+            __builtin_prefetch( &mp->tags[ j ], 1 );
+#endif
+#if MP_USE_CUCKOO == 1
+            mp_cuckoo_buckets( mp, hash[ i % MP_BATCH_SIZE ], stride, bkt );
+            __builtin_prefetch( &data[ mp_key_pos( mp, bkt[ 1 ] * mp_cuckoo_width( stride ), stride ) ], 1 );
+#endif
+        }
+    }
+}
+
+
+/**
+ * Insert or update entry with known key hash.
+ *
+ * @param mp     Mapper.
+ * @param key    Key (or Object).
+ * @param value  Value (Key Mode only).
+ * @param hash   Key hash.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_insert_hashed( mp_t mp, const po_d key, const po_d value, ag_hash_t hash, po_size_t stride )
+{
+    po_size_t pos;
+    int       found;
+
+    pos = mp_find_cur( mp, key, hash, stride, &found );
+    if ( found ) {
+        po_assign( mp->table, mp_key_pos( mp, pos, stride ), key );
+        if ( stride == 2 )
+            po_assign( mp->table, mp_value_pos( mp, pos, stride ), value );
+        return;
+    }
+
+#if MP_USE_CUCKOO == 1
+    pos = mp_cuckoo_slot( mp, pos, hash, stride );
+#endif
+
+    /* Entry is dropped, if table is full and can't grow. */
+    if ( pos == mp_slot_cnt( mp, stride ) || mp->used_cnt == po_size( mp->table ) )
+        return;
+
+    mp->used_cnt += stride;
+    if ( mp_place( mp, pos, stride, key, value, hash ) ) {
+        /* Probe limit was exceeded, grow early. */
+        mp_grow( mp, stride );
+    }
+}
+
+
+/**
+ * Delete entry.
+ *
+ * @param mp     Mapper.
+ * @param key    Key (or Object).
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Deleted Object (Object Mode), value (Key Mode) or NULL.
+ */
+static po_d mp_delete( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride )
+{
+    mp_t      tab;
+    po_size_t pos;
+    int       found;
+    po_d      ret;
+
+    mp_incr_step( mp, stride );
+
+    tab = mp;
+    pos = mp_find( tab, key, hash, stride, &found );
+
+#if MP_USE_INCR == 1
+    if ( !found && mp->old ) {
+        tab = mp->old;
+        pos = mp_find( tab, key, hash, stride, &found );
+    }
+#endif
+
+    if ( !found )
+        return NULL;
+
+    ret = po_item( tab->table, mp_value_pos( tab, pos, stride ), po_d );
+    mp_remove( tab, pos, stride );
+    mp->used_cnt -= stride;
+    mp_shrink_check( mp, stride );
+    return ret;
+}
+
+
+/**
+ * Find slot for key from current table.
+ *
+ * During incremental rehash an entry found from the old table is
+ * moved to the current table.
+ *
+ * @param mp     Mapper.
+ * @param key    Key (or Object).
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ * @param found  Set to 1 if key was found, else 0.
+ *
+ * @return Slot.
+ */
+static po_size_t mp_find_cur( mp_t mp, const po_d key, ag_hash_t hash, po_size_t stride, int* found )
+{
+    po_size_t pos;
+
+    pos = mp_find( mp, key, hash, stride, found );
+
+#if MP_USE_INCR == 1
+    if ( !*found && mp->old ) {
+        po_size_t old_pos;
+        po_d      old_key;
+        po_d      old_value;
+        old_pos = mp_find( mp->old, key, hash, stride, found );
+        if ( *found ) {
+            old_key = po_item( mp->old->table, mp_key_pos( mp->old, old_pos, stride ), po_d );
+            old_value = ( stride == 2 ) ? po_item( mp->old->table, mp_value_pos( mp->old, old_pos, stride ), po_d ) : NULL;
+            mp_remove( mp->old, old_pos, stride );
+            mp_place( mp, pos, stride, old_key, old_value, hash );
+        }
+    }
+#endif
+
+    return pos;
+}
+
+
+/**
+ * Grow table to double size.
+ *
+ * With MP_USE_INCR the entries are migrated incrementally, otherwise
+ * all at once.
+ *
+ * @param mp     Mapper.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return 0 on success, -1 if table can't be allocated.
+ */
+static int mp_grow( mp_t mp, po_size_t stride )
+{
+#if MP_USE_INCR == 1
+    mp_incr_finish( mp, stride );
+    return mp_incr_start( mp, po_size( mp->table ) * 2, stride );
+#else
+    return mp_rehash( mp, po_size( mp->table ) * 2, stride );
+#endif
+}
+
+
+/**
+ * Rehash table.
+ *
+ * With MP_USE_CUCKOO the new table is discarded and rehash restarts
+ * with double size, if an entry does not fit. If new table can't be
+ * allocated, Mapper is kept as it was.
+ *
+ * @param mp       Mapper.
+ * @param new_size New size.
+ * @param stride   Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return 0 on success, -1 if table can't be allocated.
+ */
+static int mp_rehash( mp_t mp, po_size_t new_size, po_size_t stride )
+{
+    po_t table;
+    po_s old_table;
+    mp_s old;
+#if MP_USE_STATS == 1
+    uint64_t start;
+
+    start = mp_stats_time();
+#endif
+
+    /* Old table keeps its metadata (e.g. stored hashes) until all
+     * entries are reinserted. */
+    table = mp->table;
+    old_table = *mp->table;
+    old = *mp;
+    old.table = &old_table;
+
+    for ( ;; ) {
+        mp->table = mp_table_new( mp, new_size );
+        if ( mp->table == NULL ) {
+            *mp = old;
+            mp->table = table;
+            return -1;
+        }
+        mp_meta_new( mp );
+
+#if MP_USE_THREADS == 1
+        mp->used_cnt = mp_rehash_par( mp, &old, stride );
+#else
+        mp->used_cnt = mp_rehash_range( mp, &old, stride, 0, mp_slot_cnt( &old, stride ), 0 );
+#endif
+        if ( mp->used_cnt != MP_NO_INDEX )
+            break;
+
+        mp_meta_destroy( mp );
+        mp_table_destroy( mp, mp->table );
+        new_size *= 2;
+    }
+
+#if MP_USE_STATS == 1
+    mp->stats.rehashes++;
+    mp->stats.rehash_ns += mp_stats_time() - start;
+#endif
+
+    if ( mp->rehash_cb ) {
+        mp->rehash_cb( mp, mp->rehash_env );
+    }
+
+    mp_meta_destroy( &old );
+    mp_table_destroy( &old, &old_table );
+
+    return 0;
+}
+
+
+/**
+ * Reinsert entries of old table range to current table.
+ *
+ * @param mp     Mapper.
+ * @param old    Old table.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ * @param first  First slot of range.
+ * @param last   Slot after range.
+ * @param claim  Claim slots atomically (multi-threaded rehash).
+ *
+ * @return Number of slots used by reinserted entries, or MP_NO_INDEX
+ *         if entry did not fit (MP_USE_CUCKOO).
+ */
+static po_size_t mp_rehash_range( mp_t mp, mp_t old, po_size_t stride, po_size_t first, po_size_t last, int claim )
+{
+    po_size_t cnt;
+    po_d      key;
+    po_d      value;
+
+    cnt = 0;
+    for ( po_size_t i = first; i < last; i++ ) {
+        key = po_item( old->table, mp_key_pos( old, i, stride ), po_d );
+        if ( key ) {
+            value = ( stride == 2 ) ? po_item( old->table, mp_value_pos( old, i, stride ), po_d ) : NULL;
+#if MP_USE_THREADS == 1
+            if ( claim )
+                mp_insert_claim( mp, key, value, mp_slot_hash( old, i, stride ), stride );
+            else
+#endif
+#if MP_USE_CUCKOO == 1
+                if ( mp_insert_new( mp, key, value, mp_slot_hash( old, i, stride ), stride ) )
+                    return MP_NO_INDEX;
+#else
+                mp_insert_new( mp, key, value, mp_slot_hash( old, i, stride ), stride );
+#endif
+            cnt += stride;
+        }
+    }
+    (void)claim;
+
+    return cnt;
+}
+
+
+#if MP_USE_THREADS == 1
+
+/**
+ * Rehash range (multi-threaded rehash).
+ */
+typedef struct mp_par_s
+{
+    mp_t      mp;     /**< Mapper (new table). */
+    mp_t      old;    /**< Old table. */
+    po_size_t stride; /**< Slots per entry. */
+    po_size_t first;  /**< First slot of range. */
+    po_size_t last;   /**< Slot after range. */
+    po_size_t cnt;    /**< Slots used by reinserted entries. */
+} mp_par_s;
+
+
+/**
+ * Reinsert old table entries to current table with multiple threads.
+ *
+ * Old table is split to ranges, one per thread. Caller thread
+ * processes the first range. Small tables, Robin Hood tables and
+ * cuckoo tables are rehashed serially.
+ *
+ * @param mp     Mapper.
+ * @param old    Old table.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Number of slots used by reinserted entries.
+ */
+static po_size_t mp_rehash_par( mp_t mp, mp_t old, po_size_t stride )
+{
+    pthread_t* thread;
+    mp_par_s*  par;
+    po_size_t  thr;
+    po_size_t  slots;
+    po_size_t  cnt;
+
+    thr = mp->rehash_thr;
+    slots = mp_slot_cnt( old, stride );
+
+#if MP_USE_MISS_CNT == 1 || MP_USE_CUCKOO == 1
+    /* Robin Hood and cuckoo displacement can't be done
+     * concurrently. */
+    thr = 1;
+#endif
+
+    if ( thr <= 1 || slots < MP_PAR_REHASH_MIN )
+        return mp_rehash_range( mp, old, stride, 0, slots, 0 );
+
+    thread = po_malloc( thr * sizeof( pthread_t ) );
+    par = po_malloc( thr * sizeof( mp_par_s ) );
+
+    for ( po_size_t i = 0; i < thr; i++ ) {
+        par[ i ].mp = mp;
+        par[ i ].old = old;
+        par[ i ].stride = stride;
+        par[ i ].first = ( slots / thr ) * i;
+        par[ i ].last = ( i == thr - 1 ) ? slots : ( slots / thr ) * ( i + 1 );
+        par[ i ].cnt = 0;
+    }
+
+    /* Range is done by caller if thread can't be created. */
+    for ( po_size_t i = 1; i < thr; i++ ) {
+        if ( pthread_create( &thread[ i ], NULL, mp_rehash_worker, &par[ i ] ) != 0 ) {
+            mp_rehash_worker( &par[ i ] );
+            par[ i ].mp = NULL;
+        }
+    }
+
+    mp_rehash_worker( &par[ 0 ] );
+
+    cnt = par[ 0 ].cnt;
+    for ( po_size_t i = 1; i < thr; i++ ) {
+        if ( par[ i ].mp )
+            pthread_join( thread[ i ], NULL );
+        cnt += par[ i ].cnt;
+    }
+
+    po_free( par );
+    po_free( thread );
+
+    return cnt;
+}
+
+
+/**
+ * Rehash thread.
+ *
+ * @param arg Rehash range (mp_par_s).
+ *
+ * @return NULL.
+ */
+static void* mp_rehash_worker( void* arg )
+{
+    mp_par_s* par = arg;
+
+    par->cnt = mp_rehash_range( par->mp, par->old, par->stride, par->first, par->last, 1 );
+    return NULL;
+}
+
+
+/**
+ * Iteration range (parallel iteration).
  */
-static void mp_rehash_key( mp_t mp, po_size_t new_size )
+typedef struct mp_each_par_s
 {
-    po_s old_table;
+    mp_t             mp;       /**< Mapper. */
+    mp_each_fn_p     each;     /**< Action (Object Mode). */
+    mp_each_key_fn_p each_key; /**< Action (Key Mode). */
+    void*            acc;      /**< Thread-local accumulator. */
+    po_size_t        stride;   /**< Slots per entry. */
+    po_size_t        first;    /**< First slot of range. */
+    po_size_t        last;     /**< Slot after range. */
+    int              joined;   /**< Thread to be joined. */
+} mp_each_par_s;
 
-    old_table = mp->table_desc;
-    mp->table = po_new_sized( &mp->table_desc, new_size );
-    mp->used_cnt = 0;
 
-    po_d key;
-    po_d value;
-    for ( po_size_t i = 0; i < po_size( &old_table ); i += 2 ) {
-        key = po_item( &old_table, i, po_d );
+/**
+ * Process entries with multiple threads and combine accumulators.
+ *
+ * Ranges are in entry slots (see mp_slot_cnt()), hence Key Mode
+ * ranges never split a key/value pair. Caller thread processes the
+ * first range with "acc" as accumulator, and other threads with
+ * copies of "acc". Tables below 2 * MP_PAR_EACH_MIN slots are
+ * processed by the caller alone, without allocations.
+ *
+ * @param mp       Mapper.
+ * @param each     Action for entry (Object Mode).
+ * @param each_key Action for entry (Key Mode).
+ * @param combine  Accumulator merge.
+ * @param acc      Accumulator.
+ * @param acc_size Accumulator size in bytes.
+ * @param thr      Thread count.
+ * @param stride   Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_each_run( mp_t mp, mp_each_fn_p each, mp_each_key_fn_p each_key, mp_combine_fn_p combine, void* acc, po_size_t acc_size, po_size_t thr, po_size_t stride )
+{
+    pthread_t*     thread;
+    mp_each_par_s* par;
+    char*          part;
+    po_size_t      slots;
+
+    slots = mp_slot_cnt( mp, stride );
+
+    if ( thr > slots / MP_PAR_EACH_MIN )
+        thr = slots / MP_PAR_EACH_MIN;
+
+    if ( thr <= 1 ) {
+        /* Small table, thread start-up would cost more than the
+         * iteration itself. */
+        mp_each_par_s one;
+        one.mp = mp;
+        one.each = each;
+        one.each_key = each_key;
+        one.acc = acc;
+        one.stride = stride;
+        one.first = 0;
+        one.last = slots;
+        mp_each_worker( &one );
+        return;
+    }
+
+    thread = po_malloc( thr * sizeof( pthread_t ) );
+    par = po_malloc( thr * sizeof( mp_each_par_s ) );
+    part = po_malloc( thr * acc_size );
+
+    for ( po_size_t i = 0; i < thr; i++ ) {
+        par[ i ].mp = mp;
+        par[ i ].each = each;
+        par[ i ].each_key = each_key;
+        par[ i ].acc = ( i == 0 ) ? acc : part + i * acc_size;
+        par[ i ].stride = stride;
+        par[ i ].first = ( slots / thr ) * i;
+        par[ i ].last = ( i == thr - 1 ) ? slots : ( slots / thr ) * ( i + 1 );
+        par[ i ].joined = 0;
+        if ( i > 0 )
+            memcpy( par[ i ].acc, acc, acc_size );
+    }
+
+    /* Range is done by caller if thread can't be created. */
+    for ( po_size_t i = 1; i < thr; i++ ) {
+        if ( pthread_create( &thread[ i ], NULL, mp_each_worker, &par[ i ] ) != 0 )
+            mp_each_worker( &par[ i ] );
+        else
+            par[ i ].joined = 1;
+    }
+
+    mp_each_worker( &par[ 0 ] );
+
+    for ( po_size_t i = 1; i < thr; i++ ) {
+        if ( par[ i ].joined )
+            pthread_join( thread[ i ], NULL );
+        combine( acc, par[ i ].acc );
+    }
+
+    po_free( part );
+    po_free( par );
+    po_free( thread );
+}
+
+
+/**
+ * Parallel iteration thread.
+ *
+ * @param arg Iteration range (mp_each_par_s).
+ *
+ * @return NULL.
+ */
+static void* mp_each_worker( void* arg )
+{
+    mp_each_par_s* par = arg;
+    mp_t           mp = par->mp;
+    po_d           key;
+
+    for ( po_size_t i = mp_next_used( mp, par->first, par->stride ); i < par->last; i = mp_next_used( mp, i + 1, par->stride ) ) {
+        key = po_item( mp->table, mp_key_pos( mp, i, par->stride ), po_d );
+        if ( par->stride == 1 )
+            par->each( key, par->acc );
+        else
+            par->each_key( key, po_item( mp->table, mp_value_pos( mp, i, par->stride ), po_d ), par->acc );
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Insert entry, which is known to be missing from table, while other
+ * threads are inserting (multi-threaded rehash).
+ *
+ * Key slot is claimed with compare-and-swap. Slots are never freed
+ * during rehash, hence the entry is reachable from its home slot as
+ * with serial insertion. Value and metadata are written by the
+ * claiming thread only.
+ *
+ * @param mp     Mapper.
+ * @param key    Key (or Object).
+ * @param value  Value (Key Mode only).
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_insert_claim( mp_t mp, const po_d key, const po_d value, ag_hash_t hash, po_size_t stride )
+{
+    po_size_t cnt;
+    po_size_t slot;
+    po_d*     data;
+    po_d      empty;
+
+    cnt = mp_slot_cnt( mp, stride );
+    slot = mp_home( hash, cnt );
+    data = po_data( mp->table );
+
+    for ( ;; ) {
+        empty = NULL;
+        if ( __atomic_compare_exchange_n(
+                 &data[ mp_key_pos( mp, slot, stride ) ], &empty, key, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            break;
+        slot = mp_next_pos( slot, cnt );
+    }
+
+    if ( stride == 2 )
+        data[ mp_value_pos( mp, slot, stride ) ] = value;
+    mp_meta_set( mp, slot, stride, hash );
+}
+
+#endif
+
+
+/**
+ * Migrate some entries from old table (incremental rehash).
+ *
+ * @param mp     Mapper.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_incr_step( mp_t mp, po_size_t stride )
+{
+#if MP_USE_INCR == 1
+    if ( mp->old )
+        mp_incr_run( mp, stride, mp->incr_step );
+#else
+    (void)mp;
+    (void)stride;
+#endif
+}
+
+
+/**
+ * Migrate all remaining entries from old table (incremental rehash).
+ *
+ * @param mp     Mapper.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_incr_finish( mp_t mp, po_size_t stride )
+{
+#if MP_USE_INCR == 1
+    if ( mp->old )
+        mp_incr_run( mp, stride, mp->old_left );
+#else
+    (void)mp;
+    (void)stride;
+#endif
+}
+
+
+/**
+ * Drop old table (incremental rehash), entries are not migrated.
+ *
+ * @param mp Mapper.
+ */
+static void mp_incr_abort( mp_t mp )
+{
+#if MP_USE_INCR == 1
+    if ( mp->old ) {
+#if MP_USE_STATS == 1
+        mp_stats_fold( mp, mp->old );
+#endif
+        mp_meta_destroy( mp->old );
+        mp_table_destroy( mp->old, mp->old->table );
+        po_free( mp->old );
+        mp->old = NULL;
+    }
+#else
+    (void)mp;
+#endif
+}
+
+
+#if MP_USE_INCR == 1
+
+/**
+ * Start incremental rehash.
+ *
+ * Current table becomes the old table and entries are migrated from
+ * it downwards, starting below an empty slot. Hence the migrated
+ * entry is always the tail of its probe chain and it can be removed
+ * without disturbing other entries. If old table has no empty slots,
+ * rehash is done at once. If new table can't be allocated, current
+ * table is kept.
+ *
+ * @param mp       Mapper.
+ * @param new_size New size.
+ * @param stride   Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return 0 on success, -1 if table can't be allocated.
+ */
+static int mp_incr_start( mp_t mp, po_size_t new_size, po_size_t stride )
+{
+    po_size_t cnt;
+    po_size_t pos;
+    mp_t      old;
+
+    cnt = mp_slot_cnt( mp, stride );
+    for ( pos = cnt; pos > 0; pos-- ) {
+        if ( po_item( mp->table, mp_key_pos( mp, pos - 1, stride ), po_d ) == NULL )
+            break;
+    }
+
+    if ( pos == 0 )
+        return mp_rehash( mp, new_size, stride );
+
+    old = po_malloc( sizeof( mp_s ) );
+    *old = *mp;
+    if ( mp->table == &mp->table_desc )
+        old->table = &old->table_desc;
+    old->old = NULL;
+
+    mp->table = mp_table_new( mp, new_size );
+    if ( mp->table == NULL ) {
+        /* Current table is kept. */
+        mp->table_desc = old->table_desc;
+        mp->table = ( old->table == &old->table_desc ) ? &mp->table_desc : old->table;
+        po_free( old );
+        return -1;
+    }
+
+#if MP_USE_STATS == 1
+    /* Old table counts its own searches, they are added to Mapper
+     * when old table is dropped. */
+    memset( &old->stats, 0, sizeof( mp_stats_s ) );
+    mp->stats.rehashes++;
+#endif
+
+    mp_meta_new( mp );
+    mp->old = old;
+    mp->old_pos = pos - 1;
+    mp->old_left = cnt - 1;
+
+    return 0;
+}
+
+
+/**
+ * Migrate entries from old table.
+ *
+ * @param mp     Mapper.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ * @param budget Max number of slots to visit.
+ */
+static void mp_incr_run( mp_t mp, po_size_t stride, po_size_t budget )
+{
+    mp_t      old;
+    po_size_t cnt;
+    po_d      key;
+    po_d      value;
+    ag_hash_t hash;
+#if MP_USE_STATS == 1
+    uint64_t start;
+
+    start = mp_stats_time();
+#endif
+
+    old = mp->old;
+    cnt = mp_slot_cnt( old, stride );
+
+    while ( budget > 0 && mp->old_left > 0 ) {
+
+        mp->old_pos = mp_wrap( mp->old_pos + cnt - 1, cnt );
+        mp->old_left--;
+        budget--;
+
+        key = po_item( old->table, mp_key_pos( old, mp->old_pos, stride ), po_d );
         if ( key ) {
-            value = po_item( &old_table, i + 1, po_d );
-            mp_put_key( mp, key, value );
+            hash = mp_slot_hash( old, mp->old_pos, stride );
+            value = NULL;
+            po_assign( old->table, mp_key_pos( old, mp->old_pos, stride ), NULL );
+            if ( stride == 2 ) {
+                value = po_item( old->table, mp_value_pos( old, mp->old_pos, stride ), po_d );
+                po_assign( old->table, mp_value_pos( old, mp->old_pos, stride ), NULL );
+            }
+            mp_meta_clear( old, mp->old_pos, stride );
+            mp_insert_new( mp, key, value, hash, stride );
+        }
+    }
+
+#if MP_USE_STATS == 1
+    mp->stats.rehash_ns += mp_stats_time() - start;
+#endif
+
+    if ( mp->old_left == 0 )
+        mp_incr_done( mp );
+}
+
+
+/**
+ * Complete incremental rehash.
+ *
+ * @param mp Mapper.
+ */
+static void mp_incr_done( mp_t mp )
+{
+    mp_incr_abort( mp );
+
+    if ( mp->rehash_cb ) {
+        mp->rehash_cb( mp, mp->rehash_env );
+    }
+}
+
+#endif
+
+
+/**
+ * Return occupancy bitmap size in bytes.
+ *
+ * @param mp Mapper.
+ *
+ * @return Size.
+ */
+static po_size_t mp_occ_size( mp_t mp )
+{
+    return ( ( po_size( mp->table ) >> 6 ) + 1 ) * sizeof( uint64_t );
+}
+
+
+/**
+ * Allocate occupancy bitmap for current table, unless it is already
+ * allocated as slot metadata (MP_USE_BITMAP).
+ *
+ * @param mp Mapper.
+ */
+static void mp_occ_new( mp_t mp )
+{
+    if ( mp->occ )
+        return;
+
+    mp->occ = po_malloc( mp_occ_size( mp ) );
+    memset( mp->occ, 0, mp_occ_size( mp ) );
+}
+
+
+/**
+ * Free occupancy bitmap.
+ *
+ * @param mp Mapper.
+ */
+static void mp_occ_destroy( mp_t mp )
+{
+    if ( mp->occ ) {
+        po_free( mp->occ );
+        mp->occ = NULL;
+    }
+}
+
+
+/**
+ * Return 1 if slot is occupied.
+ *
+ * @param mp   Mapper.
+ * @param slot Slot.
+ *
+ * @return 1 if occupied, else 0.
+ */
+static int mp_occ_get( mp_t mp, po_size_t slot )
+{
+    return ( mp->occ[ slot >> 6 ] >> ( slot & 63 ) ) & 1;
+}
+
+
+/**
+ * Mark slot occupied.
+ *
+ * @param mp   Mapper.
+ * @param slot Slot.
+ */
+static void mp_occ_set( mp_t mp, po_size_t slot )
+{
+    mp->occ[ slot >> 6 ] |= ( 1ULL << ( slot & 63 ) );
+}
+
+
+/**
+ * Mark slot free.
+ *
+ * @param mp   Mapper.
+ * @param slot Slot.
+ */
+static void mp_occ_clear( mp_t mp, po_size_t slot )
+{
+    mp->occ[ slot >> 6 ] &= ~( 1ULL << ( slot & 63 ) );
+}
+
+
+/**
+ * Return first used slot starting from pos.
+ *
+ * With occupancy bitmap, empty 64-slot words are skipped and the
+ * used slot within word is found with count-trailing-zeros.
+ *
+ * @param mp     Mapper.
+ * @param pos    Start slot.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Used slot (or slot count if none).
+ */
+static po_size_t mp_next_used( mp_t mp, po_size_t pos, po_size_t stride )
+{
+    po_size_t cnt;
+    uint64_t  word;
+
+    cnt = mp_slot_cnt( mp, stride );
+
+    if ( mp->occ ) {
+        while ( pos < cnt ) {
+            word = mp->occ[ pos >> 6 ] >> ( pos & 63 );
+            if ( word )
+                return pos + __builtin_ctzll( word );
+            pos = ( pos | 63 ) + 1;
+        }
+        return cnt;
+    }
+
+    while ( pos < cnt && po_item( mp->table, mp_key_pos( mp, pos, stride ), po_d ) == NULL )
+        pos++;
+
+    return pos;
+}
+
+
+/**
+ * Find slot for integer key (Integer Mode).
+ *
+ * @param mp    Mapper.
+ * @param key   Key.
+ * @param found Set to 1 if key was found, else 0.
+ *
+ * @return Slot with key or first free slot (slot count if table is
+ *         full).
+ */
+static po_size_t mp_find_u64( mp_t mp, uint64_t key, int* found )
+{
+    po_size_t cnt;
+    po_size_t slot;
+
+    cnt = mp_slot_cnt( mp, 2 );
+    slot = mp_home( mp_gen_hash_u64( key ), cnt );
+    MP_STAT( mp, lookups, 1 );
+
+    for ( po_size_t seen = 0; seen < cnt; seen++ ) {
+
+        MP_STAT( mp, probes, 1 );
+
+        if ( !mp_occ_get( mp, slot ) ) {
+            MP_STAT( mp, misses, 1 );
+            *found = 0;
+            return slot;
+        }
+
+        if ( po_item( mp->table, mp_key_pos( mp, slot, 2 ), uintptr_t ) == key ) {
+            MP_STAT( mp, hits, 1 );
+            *found = 1;
+            return slot;
+        }
+
+        slot = mp_next_pos( slot, cnt );
+    }
+
+    MP_STAT( mp, misses, 1 );
+    *found = 0;
+    return cnt;
+}
+
+
+/**
+ * Find slot for integer key, insert key (with NULL value) if missing
+ * (Integer Mode). Table is grown before the probe.
+ *
+ * @param mp       Mapper.
+ * @param key      Key.
+ * @param inserted Set to 1 if key was inserted, else 0.
+ *
+ * @return Slot of entry, or slot count if table is full and can't
+ *         grow.
+ */
+static po_size_t mp_upsert_slot_u64( mp_t mp, uint64_t key, int* inserted )
+{
+    po_size_t pos;
+    int       found;
+
+    if ( ( ( mp->used_cnt * 100 ) / po_size( mp->table ) ) >= mp->fill_lim ) {
+        mp_rehash_u64( mp, po_size( mp->table ) * 2 );
+    }
+
+    pos = mp_find_u64( mp, key, &found );
+    *inserted = !found && pos < mp_slot_cnt( mp, 2 );
+    if ( *inserted ) {
+        mp->used_cnt += 2;
+        mp_occ_set( mp, pos );
+        po_assign( mp->table, mp_key_pos( mp, pos, 2 ), (po_d)(uintptr_t)key );
+        po_assign( mp->table, mp_value_pos( mp, pos, 2 ), NULL );
+    }
+
+    return pos;
+}
+
+
+/**
+ * Rehash integer key table (Integer Mode).
+ *
+ * If new table can't be allocated, Mapper is kept as it was.
+ *
+ * @param mp       Mapper.
+ * @param new_size New size.
+ *
+ * @return 0 on success, -1 if table can't be allocated.
+ */
+static int mp_rehash_u64( mp_t mp, po_size_t new_size )
+{
+    po_t      table;
+    po_s      old_table;
+    mp_s      old;
+    uint64_t* old_occ;
+    po_size_t cnt;
+    po_size_t slot;
+    uint64_t  key;
+#if MP_USE_STATS == 1
+    uint64_t start;
+
+    start = mp_stats_time();
+#endif
+
+    table = mp->table;
+    old_table = *mp->table;
+    old.table = &old_table;
+    old.alloc = mp->alloc;
+    mp->table = mp_table_new( mp, new_size );
+    if ( mp->table == NULL ) {
+        *table = old_table;
+        mp->table = table;
+        mp->alloc = old.alloc;
+        return -1;
+    }
+
+    old_occ = mp->occ;
+    mp->occ = NULL;
+    mp_meta_destroy( mp );
+    mp_meta_new( mp );
+    mp_occ_new( mp );
+
+    cnt = mp_slot_cnt( mp, 2 );
+    for ( po_size_t i = 0; i < mp_slot_cnt( &old, 2 ); i++ ) {
+        if ( ( old_occ[ i >> 6 ] >> ( i & 63 ) ) & 1 ) {
+            key = po_item( &old_table, mp_key_pos( &old, i, 2 ), uintptr_t );
+            slot = mp_home( mp_gen_hash_u64( key ), cnt );
+            while ( mp_occ_get( mp, slot ) )
+                slot = mp_next_pos( slot, cnt );
+            po_assign( mp->table, mp_key_pos( mp, slot, 2 ), (po_d)(uintptr_t)key );
+            po_assign( mp->table, mp_value_pos( mp, slot, 2 ), po_item( &old_table, mp_value_pos( &old, i, 2 ), po_d ) );
+            mp_occ_set( mp, slot );
         }
     }
 
+#if MP_USE_STATS == 1
+    mp->stats.rehashes++;
+    mp->stats.rehash_ns += mp_stats_time() - start;
+#endif
+
     if ( mp->rehash_cb ) {
         mp->rehash_cb( mp, mp->rehash_env );
     }
 
-    po_destroy_storage( &old_table );
+    po_free( old_occ );
+    mp_table_destroy( &old, &old_table );
+
+    return 0;
+}
+
+
+#if MP_USE_STATS == 1
+
+/**
+ * Return monotonic time.
+ *
+ * @return Time (ns).
+ */
+static uint64_t mp_stats_time( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Compute table figures of statistics: entries, probe length
+ * histogram, longest probe and longest cluster.
+ *
+ * @param mp     Mapper.
+ * @param st     Statistics.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_stats_scan( mp_t mp, mp_stats_s* st, po_size_t stride )
+{
+    po_size_t cnt;
+    po_size_t home;
+    po_size_t len;
+    po_size_t run;
+    po_size_t lead;
+    int       used;
+#if MP_USE_CUCKOO == 1
+    po_size_t bkt[ 2 ];
+#endif
+
+    cnt = mp_slot_cnt( mp, stride );
+    st->slots = cnt;
+    st->entries = 0;
+    st->max_probe = 0;
+    st->max_cluster = 0;
+    memset( st->hist, 0, sizeof( st->hist ) );
+
+    /* Leading run is joined with the trailing run, since clusters
+     * wrap around the table end. */
+    run = 0;
+    lead = cnt;
+
+    for ( po_size_t i = 0; i < cnt; i++ ) {
+
+        if ( mp->occ )
+            used = mp_occ_get( mp, i );
+        else
+            used = ( po_item( mp->table, mp_key_pos( mp, i, stride ), po_d ) != NULL );
+
+        if ( !used ) {
+            if ( lead == cnt )
+                lead = run;
+            run = 0;
+            continue;
+        }
+
+        if ( mp->key_hash == NULL ) {
+            home = mp_home( mp_gen_hash_u64( po_item( mp->table, mp_key_pos( mp, i, 2 ), uintptr_t ) ), cnt );
+            len = mp_wrap( i + cnt - home, cnt );
+        } else {
+#if MP_USE_CUCKOO == 1
+            /* Probe length is 1 for entry in second bucket, and 2 for
+             * entry in stash. */
+            mp_cuckoo_buckets( mp, mp_slot_hash( mp, i, stride ), stride, bkt );
+            if ( i >= mp_cuckoo_bkt_cnt( mp, stride ) * mp_cuckoo_width( stride ) )
+                len = 2;
+            else
+                len = ( i / mp_cuckoo_width( stride ) != bkt[ 0 ] );
+            (void)home;
+#else
+            home = mp_home( mp_slot_hash( mp, i, stride ), cnt );
+            len = mp_wrap( i + cnt - home, cnt );
+#endif
+        }
+        st->hist[ ( len < MP_STATS_HIST ) ? len : MP_STATS_HIST - 1 ]++;
+        if ( len > st->max_probe )
+            st->max_probe = len;
+        st->entries++;
+
+        run++;
+        if ( run > st->max_cluster )
+            st->max_cluster = run;
+    }
+
+    if ( lead == cnt )
+        st->max_cluster = cnt;
+    else if ( lead + run > st->max_cluster )
+        st->max_cluster = lead + run;
+}
+
+#endif
+
+
+#if MP_USE_STATS == 1 && MP_USE_INCR == 1
+
+/**
+ * Add search counters of old table (incremental rehash) to Mapper.
+ *
+ * @param mp  Mapper.
+ * @param old Old table.
+ */
+static void mp_stats_fold( mp_t mp, mp_t old )
+{
+    mp->stats.lookups += old->stats.lookups;
+    mp->stats.hits += old->stats.hits;
+    mp->stats.misses += old->stats.misses;
+    mp->stats.probes += old->stats.probes;
+    mp->stats.comps += old->stats.comps;
 }
+
+#endif
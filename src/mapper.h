@@ -23,15 +23,151 @@
 #endif
 
 /** Default array fill level. */
+#if MP_USE_CUCKOO == 1
+#define MP_DEFAULT_FILL 90
+#else
 #define MP_DEFAULT_FILL 50
+#endif
+
+/** Minimum table size after shrink or compaction. */
+#define MP_MIN_SIZE 16
+
+/** Index for missing key without free slot (see mp_get_index()). */
+#define MP_NO_INDEX ( (po_size_t)-1 )
+
 
+/*
+ * Define MP_USE_MISS_CNT as 1 in order to use Robin Hood insertion.
+ * Each slot stores the probe distance of its entry. Lookups end when
+ * probe distance exceeds the distance of the resident entry, and
+ * table grows early when any probe chain exceeds miss count limit.
+ * Higher fill limits (80-90%) can be used.
+ */
 
 #if MP_USE_MISS_CNT == 1
 /** Default miss count limit for finding slot. */
 #define MP_DEFAULT_MISS_CNT 16
+/** Max miss count limit. */
+#define MP_MAX_MISS_CNT 128
+#endif
+
+
+/*
+ * Define MP_USE_TAGS as 1 in order to maintain a control byte (tag)
+ * for each slot. Tags are probed in groups (SSE2/AVX2) and the key
+ * compare function is called only for slots with matching tag.
+ */
+
+
+/*
+ * Define MP_USE_INCR as 1 in order to rehash incrementally. Old and
+ * new table are kept side by side during rehash, and each put, get
+ * and del migrates a limited number of slots from the old table.
+ */
+
+#if MP_USE_INCR == 1
+/** Default number of slots migrated per operation. */
+#define MP_DEFAULT_INCR_STEP 32
+#endif
+
+
+#if MP_USE_TAGS == 1 && MP_USE_MISS_CNT == 1
+#error "MP_USE_TAGS and MP_USE_MISS_CNT can't be used together."
+#endif
+
+
+/*
+ * Define MP_USE_CUCKOO as 1 in order to use bucketized cuckoo hashing
+ * in Object Mode and Key Mode. Table is split to cache line sized
+ * buckets, and each key has two candidate buckets (from the same key
+ * hash). Lookup visits at most the two buckets. When both buckets are
+ * full, residents are moved to their alternate buckets (shortest path
+ * with breadth-first search). If no path is found, entry is put to
+ * the stash at the end of the table, and table grows only when the
+ * stash is full. Lookups visit the stash only when it is used. Fill
+ * limits of 90-95% can be used. Integer Mode uses linear probing.
+ * Heap tables are aligned to buckets (MP_CUCKOO_ALIGN). With
+ * MP_USE_SPLIT a Key Mode bucket is a line of keys (and the matching
+ * line of values), otherwise a line of key/value pairs.
+ */
+
+#if MP_USE_CUCKOO == 1
+/** Table positions (pointers) per bucket (one cache line). */
+#define MP_CUCKOO_LINE 8
+/** Max number of residents visited when searching for room. */
+#define MP_CUCKOO_SEARCH 256
+/** Buckets per stash bucket. */
+#define MP_CUCKOO_STASH 16
+/** Table alignment in bytes (bucket per cache line). */
+#define MP_CUCKOO_ALIGN 64
+#endif
+
+#if MP_USE_CUCKOO == 1 && ( MP_USE_TAGS == 1 || MP_USE_MISS_CNT == 1 || MP_USE_INCR == 1 )
+#error "MP_USE_CUCKOO can't be used with MP_USE_TAGS, MP_USE_MISS_CNT or MP_USE_INCR."
+#endif
+
+
+/*
+ * Define MP_USE_SPLIT as 1 in order to store Key Mode keys and values
+ * in separate halves of the table. Probing touches only the key half,
+ * so more keys fit into each cache line. Key index returned by
+ * mp_get_key_index() is then the slot number.
+ */
+
+
+/*
+ * Define MP_USE_HASH as 1 in order to store the key hash of each
+ * slot. Rehash reuses stored hashes (key hash function is not
+ * called), and key compare function is called only for slots with
+ * matching hash.
+ */
+
+
+/*
+ * Define MP_USE_THREADS as 1 in order to enable multi-threaded
+ * operations (pthreads). Rehash of large tables is split between
+ * threads (see mp_set_rehash_threads()). Key hash function must then
+ * be thread-safe.
+ */
+
+#if MP_USE_THREADS == 1
+/** Minimum old table size (slots) for multi-threaded rehash. */
+#define MP_PAR_REHASH_MIN 65536
+/** Minimum number of slots per thread for parallel iteration. */
+#define MP_PAR_EACH_MIN 4096
 #endif
 
 
+/*
+ * Define MP_USE_STATS as 1 in order to collect runtime statistics:
+ * lookup, probe, key compare and rehash counters. Counters are
+ * updated without synchronization, hence they are approximate if
+ * Mapper is read from multiple threads. See mp_stats().
+ */
+
+#if MP_USE_STATS == 1
+/** Number of probe length histogram buckets (last is open-ended). */
+#define MP_STATS_HIST 16
+#endif
+
+
+/*
+ * Define MP_USE_BITMAP as 1 in order to keep an occupancy bitmap (one
+ * bit per slot) in Object Mode and Key Mode. Iteration skips empty
+ * 64-slot words of the bitmap, hence its cost is proportional to the
+ * number of entries rather than the table size. Integer Mode has the
+ * bitmap always.
+ */
+
+
+/*
+ * Define MP_USE_POW2 as 1 in order to use power of two table sizes.
+ * Slot positions are computed with masks instead of modulo and the
+ * home slot is selected with Fibonacci hashing (top bits of hash
+ * multiplied by golden ratio).
+ */
+
+
 struct mp_struct_s;
 typedef struct mp_struct_s mp_s; /**< Mapper struct. */
 typedef mp_s*              mp_t; /**< Mapper pointer. */
@@ -63,12 +199,73 @@ typedef void ( *mp_each_key_fn_p )( po_d key, po_d value, void* arg );
 
 
 /**
- * mp_rehash() and mp_rehash_key() action callback. Called after
- * rehash is done with user arg.
+ * mp_each_u64() action callback with used argument.
+ */
+typedef void ( *mp_each_u64_fn_p )( uint64_t key, po_d value, void* arg );
+
+
+/**
+ * mp_each_par() combine callback. Merge thread-local accumulator
+ * "part" to "acc".
+ */
+typedef void ( *mp_combine_fn_p )( void* acc, const void* part );
+
+
+/**
+ * mp_rehash() action callback. Called after rehash is done with user
+ * arg. With incremental rehash, called when all entries have been
+ * migrated.
  */
 typedef void ( *mp_rehash_fn_p )( mp_t mp, void* env );
 
 
+/**
+ * Table allocator.
+ *
+ * Mapper allocates and frees table storage through the allocator, if
+ * one is given at creation (see mp_new_alloc()). "alloc" returns NULL
+ * on failure. Then constructor returns NULL, and a growing table is
+ * kept as it is. Put to a full table that can't grow fails, and
+ * batch puts drop entries that don't fit. Table size in bytes is
+ * given also to "free".
+ */
+typedef struct mp_alloc_s
+{
+    void* ( *alloc )( void* env, po_size_t size );          /**< Allocate table storage. */
+    void ( *free )( void* env, void* ptr, po_size_t size ); /**< Free table storage. */
+    void* env;                                              /**< Allocator context. */
+} mp_alloc_s;
+
+typedef mp_alloc_s* mp_alloc_t; /**< Table allocator pointer. */
+
+
+#if MP_USE_STATS == 1
+
+/**
+ * Mapper statistics.
+ *
+ * Counters are accumulated by Mapper operations. Table figures are
+ * computed by mp_stats() from the current table.
+ */
+typedef struct mp_stats_s
+{
+    uint64_t  lookups;               /**< Key searches (put, get and del). */
+    uint64_t  hits;                  /**< Searches that found the key. */
+    uint64_t  misses;                /**< Searches that did not find the key. */
+    uint64_t  probes;                /**< Probe steps (tag groups with MP_USE_TAGS). */
+    uint64_t  comps;                 /**< Key compare function calls. */
+    uint64_t  rehashes;              /**< Number of rehashes. */
+    uint64_t  rehash_ns;             /**< Time spent in rehash (ns). */
+    po_size_t slots;                 /**< Table size (entry slots). */
+    po_size_t entries;               /**< Number of entries. */
+    po_size_t hist[ MP_STATS_HIST ]; /**< Entries per probe length. */
+    po_size_t max_probe;             /**< Longest probe length. */
+    po_size_t max_cluster;           /**< Longest run of used slots. */
+} mp_stats_s;
+
+#endif
+
+
 
 /**
  * Mapper struct.
@@ -81,14 +278,50 @@ struct mp_struct_s
     mp_key_comp_fn_p key_comp;   /**< Key compare function. */
     po_size_t        used_cnt;   /**< Number of entries in table. */
     po_size_t        fill_lim;   /**< Storage limit percentage. */
+    po_size_t        shrink_lim; /**< Shrink limit percentage (0: no shrink). */
     mp_rehash_fn_p   rehash_cb;  /**< Optional rehash callback. */
     void*            rehash_env; /**< Context for rehash callback. */
+    uint64_t*        occ;        /**< Occupancy bitmap (Integer Mode or MP_USE_BITMAP). */
+    mp_alloc_t       alloc;      /**< Table allocator (NULL: Postor). */
+#if MP_USE_CUCKOO == 1
+    po_size_t stash_cnt; /**< Entries in stash. */
+#endif
 #if MP_USE_MISS_CNT == 1
     po_size_t miss_cnt; /**< Miss count limit for probing. */
+    uint8_t*  dist;     /**< Slot probe distances. */
+#endif
+#if MP_USE_TAGS == 1
+    uint8_t* tags; /**< Slot tags (control bytes). */
+#endif
+#if MP_USE_HASH == 1
+    ag_hash_t* hashes; /**< Slot key hashes. */
+#endif
+#if MP_USE_THREADS == 1
+    po_size_t rehash_thr; /**< Threads for rehash. */
+#endif
+#if MP_USE_STATS == 1
+    mp_stats_s stats; /**< Statistics counters. */
+#endif
+#if MP_USE_INCR == 1
+    mp_t      old;       /**< Old table during incremental rehash. */
+    po_size_t old_pos;   /**< Last migrated slot in old table. */
+    po_size_t old_left;  /**< Slots left to migrate. */
+    po_size_t incr_step; /**< Slots to migrate per operation. */
 #endif
 };
 
 
+/**
+ * Mapper iterator (cursor).
+ */
+typedef struct mp_iter_s
+{
+    mp_t      mp;     /**< Mapper. */
+    po_size_t stride; /**< Slots per entry (1: Object Mode, 2: Key Mode). */
+    po_size_t pos;    /**< Next slot to visit. */
+} mp_iter_s;
+
+
 
 /* ------------------------------------------------------------
  * Create and destroy:
@@ -105,7 +338,7 @@ struct mp_struct_s
  *
  * @param mp Mapper or NULL.
  *
- * @return Mapper.
+ * @return Mapper (or NULL if table can't be allocated).
  */
 mp_t mp_new( mp_t mp );
 
@@ -119,10 +352,11 @@ mp_t mp_new( mp_t mp );
  * @param mp       Mapper or NULL.
  * @param key_hash Key hash function.
  * @param key_comp Key compare function.
- * @param size     Size for hash table.
+ * @param size     Size for hash table (rounded up to power of two
+ *                 with MP_USE_POW2).
  * @param fill_lim Fill limit before resize (1-100%).
  *
- * @return Mapper.
+ * @return Mapper (or NULL if table can't be allocated).
  */
 mp_t mp_new_full( mp_t mp,
                   mp_key_hash_fn_p key_hash,
@@ -131,9 +365,42 @@ mp_t mp_new_full( mp_t mp,
                   po_size_t        fill_lim );
 
 
+/**
+ * Create Mapper with table storage from allocator.
+ *
+ * Table storage is allocated with "alloc" at creation and at each
+ * rehash, and released to it when table is replaced or destroyed.
+ * Allocator must stay valid until Mapper is destroyed. See
+ * mapper_alloc.h for arena and huge-page allocators.
+ *
+ * @param mp       Mapper or NULL.
+ * @param key_hash Key hash function.
+ * @param key_comp Key compare function.
+ * @param size     Size for hash table.
+ * @param fill_lim Fill limit before resize (1-100%).
+ * @param alloc    Table allocator (NULL: Postor, or aligned heap with MP_USE_CUCKOO).
+ *
+ * @return Mapper (or NULL if table can't be allocated).
+ */
+mp_t mp_new_alloc( mp_t             mp,
+                   mp_key_hash_fn_p key_hash,
+                   mp_key_comp_fn_p key_comp,
+                   po_size_t        size,
+                   po_size_t        fill_lim,
+                   mp_alloc_t       alloc );
+
+
 /**
  * Create Mapper based on existing allocations.
  *
+ * With MP_USE_POW2 the size of "po" must be power of two.
+ *
+ * Slot metadata (e.g. tags) is allocated from heap. If user owns the
+ * storage of "po" (e.g. a buffer given to po_use()), metadata is
+ * released with mp_release_meta(). mp_destroy_table() releases also
+ * the table storage. Table allocated by growth is owned by Mapper,
+ * and it is released with mp_destroy_table() only.
+ *
  * @param mp       Mapper.
  * @param po       Postor handle.
  * @param key_hash Key hash function.
@@ -145,6 +412,40 @@ mp_t mp_new_full( mp_t mp,
 mp_t mp_use( mp_t mp, po_t po, mp_key_hash_fn_p key_hash, mp_key_comp_fn_p key_comp, po_size_t fill_lim );
 
 
+/**
+ * Create Mapper for 64-bit integer keys (Integer Mode).
+ *
+ * Keys and values are stored inline in the table (as in Key Mode)
+ * and slot occupancy is tracked with a bitmap, hence any key
+ * (including 0) can be stored. Keys are hashed with a built-in
+ * integer mixer and compared directly, no callbacks are used.
+ *
+ * If mp is NULL, descriptor is allocated from heap. This
+ * type of descriptor must be freed by the user after use.
+ *
+ * @param mp       Mapper or NULL.
+ * @param size     Size for hash table.
+ * @param fill_lim Fill limit before resize (1-100%).
+ *
+ * @return Mapper (or NULL if table can't be allocated).
+ */
+mp_t mp_new_u64( mp_t mp, po_size_t size, po_size_t fill_lim );
+
+
+/**
+ * Create Mapper for 64-bit integer keys (Integer Mode) with table
+ * storage from allocator. See mp_new_u64() and mp_new_alloc().
+ *
+ * @param mp       Mapper or NULL.
+ * @param size     Size for hash table.
+ * @param fill_lim Fill limit before resize (1-100%).
+ * @param alloc    Table allocator (NULL: Postor, or aligned heap with MP_USE_CUCKOO).
+ *
+ * @return Mapper (or NULL if table can't be allocated).
+ */
+mp_t mp_new_u64_alloc( mp_t mp, po_size_t size, po_size_t fill_lim, mp_alloc_t alloc );
+
+
 /**
  * Destroy Mapper.
  *
@@ -165,6 +466,17 @@ mp_t mp_destroy( mp_t mp );
 void mp_destroy_table( mp_t mp );
 
 
+/**
+ * Release slot metadata, but keep table storage.
+ *
+ * Used for Mapper created with mp_use(), when user owns the table
+ * storage.
+ *
+ * @param mp Mapper.
+ */
+void mp_release_meta( mp_t mp );
+
+
 /**
  * Reset Mapper, i.e. clear content.
  *
@@ -193,13 +505,80 @@ void mp_clear( mp_t mp );
 void mp_set_rehash_cb( mp_t mp, mp_rehash_fn_p cb, void* env );
 
 
+/**
+ * Set shrink limit (low-water mark). Table is halved when delete
+ * takes the fill level below the limit. Limit is clamped to quarter
+ * of the fill limit, hence the halved table must fill up again
+ * before it grows (no grow/shrink thrashing). Table is not shrunk
+ * below MP_MIN_SIZE.
+ *
+ * @param mp         Mapper.
+ * @param shrink_lim Shrink limit percentage (0: never shrink).
+ */
+void mp_set_shrink_lim( mp_t mp, po_size_t shrink_lim );
+
+
+#if MP_USE_INCR == 1
+
+/**
+ * Set number of slots migrated per operation during incremental
+ * rehash. Larger step completes rehash sooner, smaller step gives
+ * lower worst-case operation latency.
+ *
+ * @param mp   Mapper.
+ * @param step Slots per operation (at least 1).
+ */
+void mp_set_incr_step( mp_t mp, po_size_t step );
+
+#endif
+
+
+#if MP_USE_THREADS == 1
+
+/**
+ * Set number of threads used for rehash.
+ *
+ * Tables with at least MP_PAR_REHASH_MIN slots are rehashed with
+ * "thr" threads (including the caller). Old table is split into
+ * ranges, and each thread claims slots of the new table with atomic
+ * compare-and-swap. Rehash is serial with MP_USE_MISS_CNT,
+ * MP_USE_CUCKOO and in Integer Mode.
+ *
+ * @param mp  Mapper.
+ * @param thr Thread count (1: serial rehash).
+ */
+void mp_set_rehash_threads( mp_t mp, po_size_t thr );
+
+#endif
+
+
+#if MP_USE_MISS_CNT == 1
+
+/**
+ * Set miss count limit, i.e. the longest probe chain before table is
+ * grown. Limit is clamped to MP_MAX_MISS_CNT.
+ *
+ * @param mp       Mapper.
+ * @param miss_cnt Miss count limit.
+ */
+void mp_set_miss_cnt( mp_t mp, po_size_t miss_cnt );
+
+#endif
+
+
 /**
  * Return table index.
  *
+ * For a missing key the index of the free slot, where the key would
+ * be put, is returned. If there is no free slot for the key (e.g.
+ * both buckets are full with MP_USE_CUCKOO), MP_NO_INDEX is returned.
+ * With MP_USE_MISS_CNT MP_NO_INDEX is also returned, if the key would
+ * displace a resident entry.
+ *
  * @param mp    Mapper.
  * @param value Object including key.
  *
- * @return Table index.
+ * @return Table index (or MP_NO_INDEX).
  */
 po_size_t mp_get_index( mp_t mp, const po_d value );
 
@@ -207,10 +586,12 @@ po_size_t mp_get_index( mp_t mp, const po_d value );
 /**
  * Return table index using key.
  *
+ * See mp_get_index().
+ *
  * @param mp    Mapper.
  * @param key   Key.
  *
- * @return Table index.
+ * @return Table index (or MP_NO_INDEX).
  */
 po_size_t mp_get_key_index( mp_t mp, const po_d key );
 
@@ -218,6 +599,8 @@ po_size_t mp_get_key_index( mp_t mp, const po_d key );
 /**
  * Get value from Mapper with index.
  *
+ * Index outside the table (e.g. MP_NO_INDEX) gives NULL.
+ *
  * @param mp    Mapper.
  * @param index Index.
  *
@@ -226,6 +609,17 @@ po_size_t mp_get_key_index( mp_t mp, const po_d key );
 po_d mp_get_with_index( mp_t mp, po_size_t index );
 
 
+/**
+ * Get value from Mapper with key index (Key Mode).
+ *
+ * @param mp    Mapper.
+ * @param index Key index (from mp_get_key_index() or mp_put_key()).
+ *
+ * @return Value (or NULL, also for MP_NO_INDEX).
+ */
+po_d mp_get_value_with_index( mp_t mp, po_size_t index );
+
+
 /**
  * Put value to Mapper.
  *
@@ -235,7 +629,7 @@ po_d mp_get_with_index( mp_t mp, po_size_t index );
  * @param mp    Mapper.
  * @param value Object including key.
  *
- * @return Table index.
+ * @return Table index (MP_NO_INDEX if table is full and can't grow).
  */
 po_size_t mp_put( mp_t mp, const po_d value );
 
@@ -264,7 +658,7 @@ po_d mp_get( mp_t mp, const po_d value );
  * @param key   Hash key.
  * @param value Object.
  *
- * @return Table index.
+ * @return Table index (MP_NO_INDEX if table is full and can't grow).
  */
 po_size_t mp_put_key( mp_t mp, const po_d key, const po_d value );
 
@@ -280,6 +674,303 @@ po_size_t mp_put_key( mp_t mp, const po_d key, const po_d value );
 po_d mp_get_key( mp_t mp, const po_d key );
 
 
+/**
+ * Get Object from Mapper, or put it if missing (single probe).
+ *
+ * Table is grown before the probe, hence the returned slot is valid
+ * until Mapper is modified.
+ *
+ * @param mp       Mapper.
+ * @param value    Object including key.
+ * @param inserted Set to 1 if Object was put, else 0 (or NULL).
+ *
+ * @return Slot of stored Object (NULL if table is full and can't grow).
+ */
+po_d* mp_get_or_put( mp_t mp, const po_d value, int* inserted );
+
+
+/**
+ * Get value slot for Key, insert Key (with NULL value) if missing
+ * (single probe).
+ *
+ * Value can be read and updated through the returned slot, e.g.
+ * counters are updated in place. Table is grown before the probe,
+ * hence the slot is valid until Mapper is modified.
+ *
+ * @param mp       Mapper.
+ * @param key      Key.
+ * @param inserted Set to 1 if Key was inserted, else 0 (or NULL).
+ *
+ * @return Value slot (NULL if table is full and can't grow).
+ */
+po_d* mp_upsert_key( mp_t mp, const po_d key, int* inserted );
+
+
+/**
+ * Get multiple values from Mapper.
+ *
+ * Results are the same as with mp_get() for each value, but hashing
+ * and memory accesses of multiple lookups are overlapped (with
+ * prefetching).
+ *
+ * @param mp     Mapper.
+ * @param values Objects including key.
+ * @param result Found Objects (or NULL), "cnt" entries.
+ * @param cnt    Number of values.
+ *
+ * @return Number of Objects found.
+ */
+po_size_t mp_get_batch( mp_t mp, const po_d* values, po_d* result, po_size_t cnt );
+
+
+/**
+ * Get multiple values from Mapper using Keys.
+ *
+ * Results are the same as with mp_get_key() for each key, but hashing
+ * and memory accesses of multiple lookups are overlapped (with
+ * prefetching).
+ *
+ * @param mp     Mapper.
+ * @param keys   Keys to Objects.
+ * @param result Found Objects (or NULL), "cnt" entries.
+ * @param cnt    Number of keys.
+ *
+ * @return Number of Objects found.
+ */
+po_size_t mp_get_key_batch( mp_t mp, const po_d* keys, po_d* result, po_size_t cnt );
+
+
+/**
+ * Reserve table for entries (Object Mode).
+ *
+ * Table is resized at once so that "cnt" entries fit without further
+ * resizing under the current fill limit. Table is never shrunk.
+ *
+ * @param mp  Mapper.
+ * @param cnt Number of entries.
+ */
+void mp_reserve( mp_t mp, po_size_t cnt );
+
+
+/**
+ * Reserve table for entries (Key Mode and Integer Mode).
+ *
+ * See mp_reserve().
+ *
+ * @param mp  Mapper.
+ * @param cnt Number of entries.
+ */
+void mp_reserve_key( mp_t mp, po_size_t cnt );
+
+
+/**
+ * Put multiple values to Mapper.
+ *
+ * Results are the same as with mp_put() for each value. All values
+ * are hashed first, the table is resized once (see mp_reserve()) and
+ * the entries are placed in the order of their home slots, which
+ * fills the table front to back.
+ *
+ * @param mp     Mapper.
+ * @param values Objects including key.
+ * @param cnt    Number of values.
+ */
+void mp_build( mp_t mp, const po_d* values, po_size_t cnt );
+
+
+/**
+ * Put multiple key/value pairs to Mapper.
+ *
+ * Results are the same as with mp_put_key() for each pair. See
+ * mp_build().
+ *
+ * @param mp     Mapper.
+ * @param keys   Keys.
+ * @param values Values, "cnt" entries.
+ * @param cnt    Number of keys.
+ */
+void mp_build_key( mp_t mp, const po_d* keys, const po_d* values, po_size_t cnt );
+
+
+/**
+ * Put multiple values to Mapper in order.
+ *
+ * Results are the same as with mp_put() for each value in order,
+ * including the replacement of duplicates. Fill limit is checked
+ * once for the batch (see mp_reserve()). Keys are hashed and their
+ * slots prefetched MP_BATCH_SIZE entries ahead of placement, so that
+ * memory accesses of consecutive puts overlap. Unlike mp_build(), no
+ * memory is allocated for the batch.
+ *
+ * @param mp     Mapper.
+ * @param values Objects including key.
+ * @param cnt    Number of values.
+ */
+void mp_put_batch( mp_t mp, const po_d* values, po_size_t cnt );
+
+
+/**
+ * Put multiple key/value pairs to Mapper in order.
+ *
+ * Results are the same as with mp_put_key() for each pair in order.
+ * See mp_put_batch().
+ *
+ * @param mp     Mapper.
+ * @param keys   Keys.
+ * @param values Values, "cnt" entries.
+ * @param cnt    Number of keys.
+ */
+void mp_put_key_batch( mp_t mp, const po_d* keys, const po_d* values, po_size_t cnt );
+
+
+/**
+ * Put union of Mappers "a" and "b" to "dst" (Object Mode).
+ *
+ * Mappers must use the same key hash and compare functions. "dst" is
+ * reserved for the result first, and it must not be "a" or "b". If
+ * "dst" is NULL, the result size is only counted, and nothing is
+ * allocated.
+ *
+ * Counting iterates the smaller Mapper and looks up its keys from
+ * the larger one, in groups with prefetching (see mp_get_batch()).
+ *
+ * @param dst Destination Mapper (or NULL).
+ * @param a   Mapper a.
+ * @param b   Mapper b.
+ *
+ * @return Number of entries in union.
+ */
+po_size_t mp_union( mp_t dst, mp_t a, mp_t b );
+
+
+/**
+ * Put union of Mappers "a" and "b" to "dst" (Key Mode).
+ *
+ * Value of common key is taken from "a". See mp_union().
+ *
+ * @param dst Destination Mapper (or NULL).
+ * @param a   Mapper a.
+ * @param b   Mapper b.
+ *
+ * @return Number of entries in union.
+ */
+po_size_t mp_union_key( mp_t dst, mp_t a, mp_t b );
+
+
+/**
+ * Put intersection of Mappers "a" and "b" to "dst" (Object Mode).
+ *
+ * Smaller Mapper is iterated. Objects are taken from the iterated
+ * Mapper. See mp_union().
+ *
+ * @param dst Destination Mapper (or NULL).
+ * @param a   Mapper a.
+ * @param b   Mapper b.
+ *
+ * @return Number of entries in intersection.
+ */
+po_size_t mp_intersect( mp_t dst, mp_t a, mp_t b );
+
+
+/**
+ * Put intersection of Mappers "a" and "b" to "dst" (Key Mode).
+ *
+ * Values are taken from "a". See mp_intersect().
+ *
+ * @param dst Destination Mapper (or NULL).
+ * @param a   Mapper a.
+ * @param b   Mapper b.
+ *
+ * @return Number of entries in intersection.
+ */
+po_size_t mp_intersect_key( mp_t dst, mp_t a, mp_t b );
+
+
+/**
+ * Put entries of "a" missing from "b" to "dst" (Object Mode).
+ *
+ * "a" is iterated, except when only counting. See mp_union().
+ *
+ * @param dst Destination Mapper (or NULL).
+ * @param a   Mapper a.
+ * @param b   Mapper b.
+ *
+ * @return Number of entries in difference.
+ */
+po_size_t mp_diff( mp_t dst, mp_t a, mp_t b );
+
+
+/**
+ * Put entries of "a" missing from "b" to "dst" (Key Mode).
+ *
+ * See mp_diff().
+ *
+ * @param dst Destination Mapper (or NULL).
+ * @param a   Mapper a.
+ * @param b   Mapper b.
+ *
+ * @return Number of entries in difference.
+ */
+po_size_t mp_diff_key( mp_t dst, mp_t a, mp_t b );
+
+
+/**
+ * Compact table (Object Mode).
+ *
+ * Table is resized to the smallest size that holds the current
+ * entries under the fill limit (at least MP_MIN_SIZE).
+ *
+ * @param mp Mapper.
+ */
+void mp_compact( mp_t mp );
+
+
+/**
+ * Compact table (Key Mode and Integer Mode).
+ *
+ * See mp_compact().
+ *
+ * @param mp Mapper.
+ */
+void mp_compact_key( mp_t mp );
+
+
+/**
+ * Put value to Mapper using integer key (Integer Mode).
+ *
+ * @param mp    Mapper.
+ * @param key   Key.
+ * @param value Object.
+ *
+ * @return Table index (MP_NO_INDEX if table is full and can't grow).
+ */
+po_size_t mp_put_u64( mp_t mp, uint64_t key, const po_d value );
+
+
+/**
+ * Get value from Mapper using integer key (Integer Mode).
+ *
+ * @param mp  Mapper.
+ * @param key Key.
+ *
+ * @return Object (or NULL).
+ */
+po_d mp_get_u64( mp_t mp, uint64_t key );
+
+
+/**
+ * Get value slot for integer key, insert key (with NULL value) if
+ * missing (Integer Mode). See mp_upsert_key().
+ *
+ * @param mp       Mapper.
+ * @param key      Key.
+ * @param inserted Set to 1 if key was inserted, else 0 (or NULL).
+ *
+ * @return Value slot (NULL if table is full and can't grow).
+ */
+po_d* mp_upsert_u64( mp_t mp, uint64_t key, int* inserted );
+
+
 /**
  * Delete value from Mapper.
  *
@@ -302,6 +993,108 @@ po_d mp_del( mp_t mp, const po_d value );
 po_d mp_del_key( mp_t mp, const po_d key );
 
 
+/**
+ * Delete value from Mapper using integer key (Integer Mode).
+ *
+ * @param mp  Mapper.
+ * @param key Key.
+ *
+ * @return Deleted Object (or NULL).
+ */
+po_d mp_del_u64( mp_t mp, uint64_t key );
+
+
+
+/* ------------------------------------------------------------
+ * Pre-hashed access:
+ */
+
+/**
+ * Put value to Mapper with precomputed key hash.
+ *
+ * Caller must pass the hash returned by mp->key_hash for the same
+ * key, e.g. when the hash is needed also for other purposes.
+ *
+ * @param mp    Mapper.
+ * @param value Object including key.
+ * @param hash  Key hash.
+ *
+ * @return Table index (MP_NO_INDEX if table is full and can't grow).
+ */
+po_size_t mp_put_hashed( mp_t mp, const po_d value, ag_hash_t hash );
+
+
+/**
+ * Get value from Mapper with precomputed key hash.
+ *
+ * Hash must be the one returned by mp->key_hash for the key.
+ *
+ * @param mp    Mapper.
+ * @param value Object including key.
+ * @param hash  Key hash.
+ *
+ * @return Object.
+ */
+po_d mp_get_hashed( mp_t mp, const po_d value, ag_hash_t hash );
+
+
+/**
+ * Delete value from Mapper with precomputed key hash.
+ *
+ * Hash must be the one returned by mp->key_hash for the key.
+ *
+ * @param mp    Mapper.
+ * @param value Object including key.
+ * @param hash  Key hash.
+ *
+ * @return Deleted Object.
+ */
+po_d mp_del_hashed( mp_t mp, const po_d value, ag_hash_t hash );
+
+
+/**
+ * Put value to Mapper using Key with precomputed key hash.
+ *
+ * Hash must be the one returned by mp->key_hash for the key.
+ *
+ * @param mp    Mapper.
+ * @param key   Hash key.
+ * @param value Object.
+ * @param hash  Key hash.
+ *
+ * @return Table index (MP_NO_INDEX if table is full and can't grow).
+ */
+po_size_t mp_put_key_hashed( mp_t mp, const po_d key, const po_d value, ag_hash_t hash );
+
+
+/**
+ * Get value from Mapper using Key with precomputed key hash.
+ *
+ * Hash must be the one returned by mp->key_hash for the key.
+ *
+ * @param mp   Mapper.
+ * @param key  Key to Object.
+ * @param hash Key hash.
+ *
+ * @return Object.
+ */
+po_d mp_get_key_hashed( mp_t mp, const po_d key, ag_hash_t hash );
+
+
+/**
+ * Delete value from Mapper using Key with precomputed key hash.
+ *
+ * Hash must be the one returned by mp->key_hash for the key.
+ *
+ * @param mp   Mapper.
+ * @param key  Key to Object.
+ * @param hash Key hash.
+ *
+ * @return Deleted Object.
+ */
+po_d mp_del_key_hashed( mp_t mp, const po_d key, ag_hash_t hash );
+
+
 
 /* ------------------------------------------------------------
  * Access functions:
@@ -369,4 +1162,150 @@ void mp_each( mp_t mp, mp_each_fn_p action, void* arg );
 void mp_each_key( mp_t mp, mp_each_key_fn_p action, void* arg );
 
 
+/**
+ * Process each entry in Mapper (Integer Mode).
+ *
+ * @param mp     Mapper.
+ * @param action Action for entry.
+ * @param arg    User argument for action.
+ */
+void mp_each_u64( mp_t mp, mp_each_u64_fn_p action, void* arg );
+
+
+/**
+ * Initialize iterator to the first entry of Mapper (Object Mode).
+ *
+ * Iteration can be stopped at any point and resumed later with
+ * mp_iter_next(). Mapper must not be modified between calls,
+ * since put and del move entries and rehash replaces the table.
+ *
+ * @param mp Mapper.
+ * @param it Iterator.
+ */
+void mp_iter_init( mp_t mp, mp_iter_s* it );
+
+
+/**
+ * Initialize iterator to the first entry of Mapper (Key Mode and
+ * Integer Mode).
+ *
+ * See mp_iter_init().
+ *
+ * @param mp Mapper.
+ * @param it Iterator.
+ */
+void mp_iter_init_key( mp_t mp, mp_iter_s* it );
+
+
+/**
+ * Get next entry and advance iterator.
+ *
+ * In Object Mode both key and value are the Object. In Integer Mode
+ * key is the integer key (cast to po_d). Key or value may be NULL,
+ * if not needed.
+ *
+ * @param it    Iterator.
+ * @param key   Entry key.
+ * @param value Entry value.
+ *
+ * @return 1 if entry was returned, 0 at end.
+ */
+int mp_iter_next( mp_iter_s* it, po_d* key, po_d* value );
+
+
+#if MP_USE_THREADS == 1
+
+/**
+ * Process each entry in Mapper with multiple threads (Object Mode).
+ *
+ * Table is split to slot ranges, one per thread (including the
+ * caller). Each thread gets its own accumulator, which is a copy of
+ * "acc" at entry, and passes it to "action" as user argument. When
+ * all threads are done, the accumulators are merged to "acc" with
+ * "combine" by the caller. Hence "acc" must hold the identity value
+ * of the reduction (e.g. zero for sum) at entry.
+ *
+ * Thread count is reduced so that each thread gets at least
+ * MP_PAR_EACH_MIN slots. Hence tables below 2 * MP_PAR_EACH_MIN
+ * slots are iterated serially by the caller, and no threads are
+ * started. Mapper must not be modified during the call.
+ *
+ * @param mp       Mapper.
+ * @param action   Action for entry.
+ * @param combine  Accumulator merge.
+ * @param acc      Accumulator (identity at entry, result at return).
+ * @param acc_size Accumulator size in bytes.
+ * @param thr      Thread count.
+ */
+void mp_each_par( mp_t            mp,
+                  mp_each_fn_p    action,
+                  mp_combine_fn_p combine,
+                  void*           acc,
+                  po_size_t       acc_size,
+                  po_size_t       thr );
+
+
+/**
+ * Process each entry in Mapper with multiple threads (Key Mode and
+ * Integer Mode).
+ *
+ * Slot ranges are split at entry boundaries, hence key and value are
+ * always processed by the same thread. In Integer Mode key is the
+ * integer key (cast to po_d). See mp_each_par().
+ *
+ * @param mp       Mapper.
+ * @param action   Action for entry.
+ * @param combine  Accumulator merge.
+ * @param acc      Accumulator (identity at entry, result at return).
+ * @param acc_size Accumulator size in bytes.
+ * @param thr      Thread count.
+ */
+void mp_each_key_par( mp_t             mp,
+                      mp_each_key_fn_p action,
+                      mp_combine_fn_p  combine,
+                      void*            acc,
+                      po_size_t        acc_size,
+                      po_size_t        thr );
+
+#endif
+
+
+#if MP_USE_STATS == 1
+
+/**
+ * Get Mapper statistics (Object Mode).
+ *
+ * Counters are copied from Mapper. Probe length histogram and the
+ * longest cluster are computed from the table, hence the call visits
+ * all slots. Probe length is the distance of entry from its home
+ * slot (with MP_USE_CUCKOO 1 for entries in their second bucket).
+ *
+ * @param mp Mapper.
+ * @param st Statistics.
+ */
+void mp_stats( mp_t mp, mp_stats_s* st );
+
+
+/**
+ * Get Mapper statistics (Key Mode and Integer Mode).
+ *
+ * See mp_stats().
+ *
+ * @param mp Mapper.
+ * @param st Statistics.
+ */
+void mp_stats_key( mp_t mp, mp_stats_s* st );
+
+
+/**
+ * Reset statistics counters, e.g. to sample statistics over time
+ * windows.
+ *
+ * @param mp Mapper.
+ */
+void mp_stats_reset( mp_t mp );
+
+#endif
+
+
 #endif
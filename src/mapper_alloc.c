@@ -0,0 +1,306 @@
+/**
+ * @file   mapper_alloc.c
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 22:23:11 2026
+ *
+ * @brief  Mapper alloc - Table allocators.
+ *
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mapper_alloc.h"
+
+
+static po_size_t mp_huge_len( po_size_t size );
+static void*     mp_huge_alloc( void* env, po_size_t size );
+static void      mp_huge_free( void* env, void* ptr, po_size_t size );
+static po_size_t mp_arena_len( po_size_t size );
+static void*     mp_arena_alloc( void* env, po_size_t size );
+static void      mp_arena_free( void* env, void* ptr, po_size_t size );
+
+
+
+/* ------------------------------------------------------------
+ * Create and destroy:
+ */
+
+mp_alloc_t mp_alloc_huge( mp_alloc_t alloc )
+{
+    alloc->alloc = mp_huge_alloc;
+    alloc->free = mp_huge_free;
+    alloc->env = NULL;
+    return alloc;
+}
+
+
+mp_arena_t mp_arena_new( mp_arena_t arena, po_size_t size, int huge )
+{
+    if ( arena == NULL ) {
+        arena = po_malloc( sizeof( mp_arena_s ) );
+    }
+
+    arena->alloc.alloc = mp_arena_alloc;
+    arena->alloc.free = mp_arena_free;
+    arena->alloc.env = arena;
+    arena->huge = huge;
+    arena->size = mp_arena_len( size );
+    arena->top = 0;
+    arena->free = NULL;
+
+    if ( huge ) {
+        arena->base = mp_huge_alloc( NULL, arena->size );
+    } else if ( posix_memalign( (void**)&arena->base, MP_ARENA_ALIGN, arena->size ) != 0 ) {
+        arena->base = NULL;
+    }
+
+    /* All tables from heap, if region is not available. */
+    if ( arena->base == NULL )
+        arena->size = 0;
+
+    return arena;
+}
+
+
+mp_arena_t mp_arena_destroy( mp_arena_t arena )
+{
+    mp_arena_destroy_region( arena );
+    po_free( arena );
+    return NULL;
+}
+
+
+void mp_arena_destroy_region( mp_arena_t arena )
+{
+    if ( arena->base ) {
+        if ( arena->huge )
+            mp_huge_free( NULL, arena->base, arena->size );
+        else
+            free( arena->base );
+    }
+    arena->base = NULL;
+    arena->size = 0;
+    arena->top = 0;
+    arena->free = NULL;
+}
+
+
+
+/* ------------------------------------------------------------
+ * Access functions:
+ */
+
+po_size_t mp_arena_used( mp_arena_t arena )
+{
+    return arena->top;
+}
+
+
+
+/* ------------------------------------------------------------
+ * Internal support:
+ */
+
+/**
+ * Return mapping length for size. Large mappings are rounded to huge
+ * pages, so that the same length is used with and without
+ * MAP_HUGETLB.
+ *
+ * @param size Size in bytes.
+ *
+ * @return Mapping length.
+ */
+static po_size_t mp_huge_len( po_size_t size )
+{
+    po_size_t page;
+
+    if ( size >= MP_HUGE_PAGE )
+        page = MP_HUGE_PAGE;
+    else
+        page = sysconf( _SC_PAGESIZE );
+
+    return ( ( size + page - 1 ) / page ) * page;
+}
+
+
+/**
+ * Allocate with huge pages, if possible.
+ *
+ * @param env  Not used.
+ * @param size Size in bytes.
+ *
+ * @return Allocation (or NULL).
+ */
+static void* mp_huge_alloc( void* env, po_size_t size )
+{
+    po_size_t len;
+    void*     ptr;
+
+    (void)env;
+
+    len = mp_huge_len( size );
+    ptr = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if ( len >= MP_HUGE_PAGE )
+        ptr = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+#endif
+
+    if ( ptr == MAP_FAILED ) {
+        ptr = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( ptr == MAP_FAILED )
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        /* Advice only, failure is not an error. */
+        if ( len >= MP_HUGE_PAGE )
+            madvise( ptr, len, MADV_HUGEPAGE );
+#endif
+    }
+
+    return ptr;
+}
+
+
+/**
+ * Free huge-page allocation.
+ *
+ * @param env  Not used.
+ * @param ptr  Allocation.
+ * @param size Size in bytes.
+ */
+static void mp_huge_free( void* env, void* ptr, po_size_t size )
+{
+    (void)env;
+    munmap( ptr, mp_huge_len( size ) );
+}
+
+
+/**
+ * Return arena block length for size.
+ *
+ * @param size Size in bytes.
+ *
+ * @return Block length.
+ */
+static po_size_t mp_arena_len( po_size_t size )
+{
+    if ( size < sizeof( mp_arena_blk_s ) )
+        size = sizeof( mp_arena_blk_s );
+
+    return ( ( size + MP_ARENA_ALIGN - 1 ) / MP_ARENA_ALIGN ) * MP_ARENA_ALIGN;
+}
+
+
+/**
+ * Allocate block from arena.
+ *
+ * Smallest free block that fits is used, and its tail is returned to
+ * the free list. Otherwise block is taken from the end of the region,
+ * or from heap when region is full.
+ *
+ * @param env  Arena.
+ * @param size Size in bytes.
+ *
+ * @return Allocation.
+ */
+static void* mp_arena_alloc( void* env, po_size_t size )
+{
+    mp_arena_t       arena = env;
+    mp_arena_blk_s** best;
+    mp_arena_blk_s*  blk;
+    mp_arena_blk_s*  rest;
+    po_size_t        len;
+
+    len = mp_arena_len( size );
+
+    best = NULL;
+    for ( mp_arena_blk_s** p = &arena->free; *p; p = &( *p )->next ) {
+        if ( ( *p )->size >= len && ( best == NULL || ( *p )->size < ( *best )->size ) )
+            best = p;
+    }
+
+    if ( best ) {
+        blk = *best;
+        if ( blk->size - len >= MP_ARENA_ALIGN ) {
+            rest = (mp_arena_blk_s*)( (char*)blk + len );
+            rest->size = blk->size - len;
+            rest->next = blk->next;
+            *best = rest;
+        } else {
+            *best = blk->next;
+        }
+        return blk;
+    }
+
+    if ( arena->size - arena->top >= len ) {
+        blk = (mp_arena_blk_s*)( arena->base + arena->top );
+        arena->top += len;
+        return blk;
+    }
+
+    return po_malloc( size );
+}
+
+
+/**
+ * Return block to arena.
+ *
+ * Block is merged with adjacent free blocks. Free space at the end of
+ * the region is returned to the region.
+ *
+ * @param env  Arena.
+ * @param ptr  Allocation.
+ * @param size Size in bytes.
+ */
+static void mp_arena_free( void* env, void* ptr, po_size_t size )
+{
+    mp_arena_t       arena = env;
+    mp_arena_blk_s*  blk = ptr;
+    mp_arena_blk_s** p;
+    mp_arena_blk_s*  prev;
+
+    if ( (char*)ptr < arena->base || (char*)ptr >= arena->base + arena->size ) {
+        po_free( ptr );
+        return;
+    }
+
+    blk->size = mp_arena_len( size );
+
+    prev = NULL;
+    p = &arena->free;
+    while ( *p && *p < blk ) {
+        prev = *p;
+        p = &( *p )->next;
+    }
+
+    /* Merge with next. */
+    if ( *p && (char*)blk + blk->size == (char*)*p ) {
+        blk->size += ( *p )->size;
+        blk->next = ( *p )->next;
+    } else {
+        blk->next = *p;
+    }
+
+    /* Merge with previous. */
+    if ( prev && (char*)prev + prev->size == (char*)blk ) {
+        prev->size += blk->size;
+        prev->next = blk->next;
+        blk = prev;
+    } else {
+        *p = blk;
+    }
+
+    /* Last block is given back to the region. */
+    if ( (char*)blk + blk->size == arena->base + arena->top && blk->next == NULL ) {
+        arena->top -= blk->size;
+        if ( blk == arena->free ) {
+            arena->free = NULL;
+        } else {
+            for ( prev = arena->free; prev->next != blk; prev = prev->next )
+                ;
+            prev->next = NULL;
+        }
+    }
+}
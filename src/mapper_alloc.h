@@ -0,0 +1,135 @@
+#ifndef MAPPER_ALLOC_H
+#define MAPPER_ALLOC_H
+
+/**
+ * @file   mapper_alloc.h
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 22:23:11 2026
+ *
+ * @brief  Mapper alloc - Table allocators.
+ *
+ * Huge-page allocator maps each table separately. Tables of at least
+ * MP_HUGE_PAGE bytes are mapped with MAP_HUGETLB, and if no huge
+ * pages are reserved, with normal pages and MADV_HUGEPAGE
+ * (transparent huge pages). Where neither is available, tables are
+ * plain anonymous mappings.
+ *
+ * Arena allocator reserves one region, optionally with the
+ * huge-page allocator, and draws tables from it. Freed tables are
+ * kept in an address ordered free list, where adjacent blocks are
+ * merged, and reused by later tables that fit. Hence rehash does not
+ * fragment the heap. Tables that do not fit to the region are
+ * allocated from heap.
+ *
+ * Allocators are not thread-safe. Mappers sharing an allocator must
+ * be used from one thread at a time.
+ *
+ */
+
+#include "mapper.h"
+
+
+/** Huge page size. */
+#define MP_HUGE_PAGE ( 2 * 1024 * 1024 )
+
+/** Arena block alignment (cache line size). */
+#define MP_ARENA_ALIGN 64
+
+
+/**
+ * Free block in arena (stored in the block itself).
+ */
+typedef struct mp_arena_blk_s
+{
+    po_size_t              size; /**< Block size. */
+    struct mp_arena_blk_s* next; /**< Next free block. */
+} mp_arena_blk_s;
+
+
+/**
+ * Arena allocator.
+ */
+typedef struct mp_arena_s
+{
+    mp_alloc_s      alloc; /**< Allocator for mp_new_alloc(). */
+    int             huge;  /**< Region from huge-page allocator. */
+    char*           base;  /**< Region. */
+    po_size_t       size;  /**< Region size. */
+    po_size_t       top;   /**< Region usage (end of last block). */
+    mp_arena_blk_s* free;  /**< Free blocks (in address order). */
+} mp_arena_s;
+
+typedef mp_arena_s* mp_arena_t; /**< Arena allocator pointer. */
+
+
+
+/* ------------------------------------------------------------
+ * Create and destroy:
+ */
+
+
+/**
+ * Initialize huge-page allocator.
+ *
+ * @param alloc Allocator.
+ *
+ * @return Allocator.
+ */
+mp_alloc_t mp_alloc_huge( mp_alloc_t alloc );
+
+
+/**
+ * Create arena allocator.
+ *
+ * If arena is NULL, descriptor is allocated from heap. This type of
+ * descriptor must be freed by the user after use.
+ *
+ * Use "&arena->alloc" as the Mapper allocator.
+ *
+ * @param arena Arena or NULL.
+ * @param size  Region size in bytes.
+ * @param huge  Region from huge-page allocator (else from heap).
+ *
+ * @return Arena.
+ */
+mp_arena_t mp_arena_new( mp_arena_t arena, po_size_t size, int huge );
+
+
+/**
+ * Destroy arena allocator.
+ *
+ * Mappers using the arena must be destroyed first.
+ *
+ * @param arena Arena.
+ *
+ * @return NULL.
+ */
+mp_arena_t mp_arena_destroy( mp_arena_t arena );
+
+
+/**
+ * Destroy arena region.
+ *
+ * @param arena Arena.
+ */
+void mp_arena_destroy_region( mp_arena_t arena );
+
+
+
+/* ------------------------------------------------------------
+ * Access functions:
+ */
+
+
+/**
+ * Return number of region bytes drawn (end of last block), including
+ * freed blocks that are not at the end.
+ *
+ * @param arena Arena.
+ *
+ * @return Bytes drawn.
+ */
+po_size_t mp_arena_used( mp_arena_t arena );
+
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef MAPPER_GEN_H
+#define MAPPER_GEN_H
+
+/**
+ * @file   mapper_gen.h
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 20:21:32 2026
+ *
+ * @brief  Mapper generator - Statically typed hash table (map).
+ *
+ * MP_DEFINE_MAP() generates a map type and its functions for given
+ * key and value types. Hash and compare are inlined into the
+ * generated functions, and keys and values are stored by value (no
+ * pointer indirection). The map uses the same open addressing
+ * (linear probing), fill limit and backward-shift deletion as Mapper.
+ * Table size is power of two and home slot is selected with Fibonacci
+ * hashing.
+ *
+ * Example:
+ *
+ *     #define hash_u64( k ) mp_gen_hash_u64( k )
+ *     #define eq_u64( a, b ) ( ( a ) == ( b ) )
+ *     MP_DEFINE_MAP( imap, uint64_t, void*, hash_u64, eq_u64 )
+ *
+ *     imap_s m;
+ *     imap_new( &m, 32, 50 );
+ *     imap_put( &m, 12, obj );
+ *     obj = *imap_get( &m, 12 );
+ *     imap_destroy_table( &m );
+ *
+ * Generated functions (for "name"):
+ *
+ * - name_new( m, size, fill_lim ): Create map (m is allocated if NULL).
+ * - name_destroy( m ): Free table storage and map (from heap).
+ * - name_destroy_table( m ): Free table storage.
+ * - name_put( m, key, value ): Put entry, return 1 if key was new.
+ * - name_get( m, key ): Return pointer to value, or NULL.
+ * - name_del( m, key, value ): Delete entry, return 1 if found.
+ *   Deleted value is stored to "value" if not NULL.
+ * - name_each( m, action, arg ): Call action( key, value, arg ) for
+ *   each entry.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <postor.h>
+
+
+/** Fibonacci hashing multiplier (2^64 / golden ratio). */
+#define MP_GEN_FIB_MULT 0x9E3779B97F4A7C15ULL
+
+
+/**
+ * Hash (mix) for 64-bit integer keys.
+ *
+ * @param key Key.
+ *
+ * @return 64-bit hash.
+ */
+static inline uint64_t mp_gen_hash_u64( uint64_t key )
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+
+/**
+ * Define map type "name_s" (and "name_t") and its functions.
+ *
+ * @param name       Map name (prefix for type and functions).
+ * @param key_type   Key type.
+ * @param value_type Value type.
+ * @param hash_expr  Hash function (or macro) for key, returns 64 bits.
+ * @param eq_expr    Equality function (or macro) for two keys.
+ */
+#define MP_DEFINE_MAP( name, key_type, value_type, hash_expr, eq_expr )                         \
+                                                                                                \
+    typedef struct name##_s                                                                     \
+    {                                                                                           \
+        key_type*   keys;     /* Keys. */                                                       \
+        value_type* values;   /* Values. */                                                     \
+        uint8_t*    used;     /* Slot in use flags. */                                          \
+        size_t      size;     /* Table size (power of two). */                                  \
+        size_t      shift;    /* Shift for home slot (64 - log2(size)). */                      \
+        size_t      used_cnt; /* Number of entries. */                                          \
+        size_t      fill_lim; /* Fill limit percentage. */                                      \
+    } name##_s;                                                                                 \
+    typedef name##_s* name##_t;                                                                 \
+                                                                                                \
+    static inline size_t name##_home( name##_t m, key_type key )                                \
+    {                                                                                           \
+        return (size_t)( ( (uint64_t)( hash_expr( key ) ) * MP_GEN_FIB_MULT ) >> m->shift );    \
+    }                                                                                           \
+                                                                                                \
+    static inline void name##_alloc( name##_t m, size_t size )                                  \
+    {                                                                                           \
+        m->size = 2;                                                                            \
+        m->shift = 63;                                                                          \
+        while ( m->size < size ) {                                                              \
+            m->size <<= 1;                                                                      \
+            m->shift--;                                                                         \
+        }                                                                                       \
+        m->keys = po_malloc( m->size * sizeof( key_type ) );                                    \
+        m->values = po_malloc( m->size * sizeof( value_type ) );                                \
+        m->used = po_malloc( m->size );                                                         \
+        memset( m->used, 0, m->size );                                                          \
+        m->used_cnt = 0;                                                                        \
+    }                                                                                           \
+                                                                                                \
+    static inline name##_t name##_new( name##_t m, size_t size, size_t fill_lim )               \
+    {                                                                                           \
+        if ( m == NULL )                                                                        \
+            m = po_malloc( sizeof( name##_s ) );                                                \
+        name##_alloc( m, size );                                                                \
+        m->fill_lim = fill_lim;                                                                 \
+        return m;                                                                               \
+    }                                                                                           \
+                                                                                                \
+    static inline void name##_destroy_table( name##_t m )                                       \
+    {                                                                                           \
+        po_free( m->keys );                                                                     \
+        po_free( m->values );                                                                   \
+        po_free( m->used );                                                                     \
+    }                                                                                           \
+                                                                                                \
+    static inline name##_t name##_destroy( name##_t m )                                         \
+    {                                                                                           \
+        name##_destroy_table( m );                                                              \
+        po_free( m );                                                                           \
+        return NULL;                                                                            \
+    }                                                                                           \
+                                                                                                \
+    static inline size_t name##_find( name##_t m, key_type key, int* found )                    \
+    {                                                                                           \
+        size_t mask = m->size - 1;                                                              \
+        size_t pos = name##_home( m, key );                                                     \
+        for ( size_t n = 0; n < m->size && m->used[ pos ]; n++ ) {                              \
+            if ( eq_expr( m->keys[ pos ], key ) ) {                                             \
+                *found = 1;                                                                     \
+                return pos;                                                                     \
+            }                                                                                   \
+            pos = ( pos + 1 ) & mask;                                                           \
+        }                                                                                       \
+        *found = 0;                                                                             \
+        return pos;                                                                             \
+    }                                                                                           \
+                                                                                                \
+    static inline void name##_insert_new( name##_t m, key_type key, value_type value )          \
+    {                                                                                           \
+        size_t mask = m->size - 1;                                                              \
+        size_t pos = name##_home( m, key );                                                     \
+        while ( m->used[ pos ] )                                                                \
+            pos = ( pos + 1 ) & mask;                                                           \
+        m->keys[ pos ] = key;                                                                   \
+        m->values[ pos ] = value;                                                               \
+        m->used[ pos ] = 1;                                                                     \
+        m->used_cnt++;                                                                          \
+    }                                                                                           \
+                                                                                                \
+    static inline void name##_rehash( name##_t m, size_t new_size )                             \
+    {                                                                                           \
+        name##_s old = *m;                                                                      \
+        name##_alloc( m, new_size );                                                            \
+        for ( size_t i = 0; i < old.size; i++ ) {                                               \
+            if ( old.used[ i ] )                                                                \
+                name##_insert_new( m, old.keys[ i ], old.values[ i ] );                         \
+        }                                                                                       \
+        name##_destroy_table( &old );                                                          \
+    }                                                                                           \
+                                                                                                \
+    static inline int name##_put( name##_t m, key_type key, value_type value )                  \
+    {                                                                                           \
+        size_t pos;                                                                             \
+        int    found;                                                                           \
+        if ( ( ( m->used_cnt * 100 ) / m->size ) >= m->fill_lim )                               \
+            name##_rehash( m, m->size * 2 );                                                    \
+        pos = name##_find( m, key, &found );                                                    \
+        m->keys[ pos ] = key;                                                                   \
+        m->values[ pos ] = value;                                                               \
+        if ( found )                                                                            \
+            return 0;                                                                           \
+        m->used[ pos ] = 1;                                                                     \
+        m->used_cnt++;                                                                          \
+        return 1;                                                                               \
+    }                                                                                           \
+                                                                                                \
+    static inline value_type* name##_get( name##_t m, key_type key )                            \
+    {                                                                                           \
+        size_t pos;                                                                             \
+        int    found;                                                                           \
+        pos = name##_find( m, key, &found );                                                    \
+        return found ? &m->values[ pos ] : NULL;                                                \
+    }                                                                                           \
+                                                                                                \
+    static inline int name##_del( name##_t m, key_type key, value_type* value )                 \
+    {                                                                                           \
+        size_t mask = m->size - 1;                                                              \
+        size_t hole;                                                                            \
+        size_t home;                                                                            \
+        int    found;                                                                           \
+        hole = name##_find( m, key, &found );                                                   \
+        if ( !found )                                                                           \
+            return 0;                                                                           \
+        if ( value )                                                                            \
+            *value = m->values[ hole ];                                                         \
+        m->used[ hole ] = 0;                                                                    \
+        m->used_cnt--;                                                                          \
+        for ( size_t pos = ( hole + 1 ) & mask; m->used[ pos ]; pos = ( pos + 1 ) & mask ) {    \
+            home = name##_home( m, m->keys[ pos ] );                                            \
+            if ( ( ( pos - home ) & mask ) >= ( ( pos - hole ) & mask ) ) {                     \
+                m->keys[ hole ] = m->keys[ pos ];                                               \
+                m->values[ hole ] = m->values[ pos ];                                           \
+                m->used[ hole ] = 1;                                                            \
+                m->used[ pos ] = 0;                                                             \
+                hole = pos;                                                                     \
+            }                                                                                   \
+        }                                                                                       \
+        return 1;                                                                               \
+    }                                                                                           \
+                                                                                                \
+    static inline void name##_each(                                                             \
+        name##_t m, void ( *action )( key_type key, value_type value, void* arg ), void* arg )  \
+    {                                                                                           \
+        for ( size_t i = 0; i < m->size; i++ ) {                                                \
+            if ( m->used[ i ] )                                                                 \
+                action( m->keys[ i ], m->values[ i ], arg );                                    \
+        }                                                                                       \
+    }
+
+#endif
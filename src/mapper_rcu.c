@@ -0,0 +1,558 @@
+/**
+ * @file   mapper_rcu.c
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 20:41:41 2026
+ *
+ * @brief  Mapper RCU - Read-mostly Mapper with lock-free readers.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "mapper_rcu.h"
+#include "mapper_gen.h"
+
+
+/** Minimum table size (two Key Mode entries). */
+#define MP_RCU_MIN_SIZE 4
+
+
+/** Tombstone, i.e. deleted slot marker. */
+static char mp_rcu_tomb;
+#define MP_RCU_TOMB ( (po_d)&mp_rcu_tomb )
+
+
+static mp_rcu_table_s* mp_rcu_table_new( po_size_t size );
+static po_size_t       mp_rcu_home( mp_rcu_table_s* tab, ag_hash_t hash, po_size_t stride );
+static po_size_t       mp_rcu_find( mp_rcu_t mp, mp_rcu_table_s* tab, const po_d key, ag_hash_t hash, po_size_t stride, po_d* item );
+static mp_rcu_table_s* mp_rcu_enter( mp_rcu_t mp, mp_rcu_reader_t rd );
+static void            mp_rcu_leave( mp_rcu_reader_t rd );
+static po_d            mp_rcu_lookup( mp_rcu_t mp, mp_rcu_reader_t rd, const po_d key, po_size_t stride );
+static void            mp_rcu_insert( mp_rcu_t mp, const po_d key, const po_d value, po_size_t stride );
+static po_d            mp_rcu_delete( mp_rcu_t mp, const po_d key, po_size_t stride );
+static void            mp_rcu_walk( mp_rcu_t mp, mp_rcu_reader_t rd, mp_each_fn_p action, mp_each_key_fn_p key_action, void* arg );
+static void            mp_rcu_rehash( mp_rcu_t mp, po_size_t stride );
+static void            mp_rcu_free_retired( mp_rcu_t mp );
+
+
+
+/* ------------------------------------------------------------
+ * Create and destroy:
+ */
+
+mp_rcu_t mp_rcu_new( mp_rcu_t mp, mp_key_hash_fn_p key_hash, mp_key_comp_fn_p key_comp, po_size_t size, po_size_t fill_lim )
+{
+    if ( mp == NULL ) {
+        mp = po_malloc( sizeof( mp_rcu_s ) );
+    }
+
+    mp->table = mp_rcu_table_new( size );
+    mp->epoch = 1;
+    mp->key_hash = key_hash;
+    mp->key_comp = key_comp;
+    mp->used_cnt = 0;
+    mp->fill_cnt = 0;
+    mp->fill_lim = fill_lim;
+    mp->readers = NULL;
+    mp->retired = NULL;
+    pthread_mutex_init( &mp->lock, NULL );
+
+    return mp;
+}
+
+
+mp_rcu_t mp_rcu_destroy( mp_rcu_t mp )
+{
+    mp_rcu_destroy_table( mp );
+    po_free( mp );
+    return NULL;
+}
+
+
+void mp_rcu_destroy_table( mp_rcu_t mp )
+{
+    mp_rcu_reader_s*  rd;
+    mp_rcu_retired_s* r;
+
+    while ( mp->retired ) {
+        r = mp->retired;
+        mp->retired = r->next;
+        po_free( r->table );
+        po_free( r );
+    }
+
+    while ( mp->readers ) {
+        rd = mp->readers;
+        mp->readers = rd->next;
+        free( rd );
+    }
+
+    po_free( mp->table );
+    mp->table = NULL;
+    pthread_mutex_destroy( &mp->lock );
+}
+
+
+mp_rcu_reader_t mp_rcu_reader_new( mp_rcu_t mp )
+{
+    mp_rcu_reader_s* rd;
+
+    pthread_mutex_lock( &mp->lock );
+
+    for ( rd = mp->readers; rd; rd = rd->next ) {
+        if ( !rd->used )
+            break;
+    }
+
+    if ( rd == NULL ) {
+        if ( posix_memalign( (void**)&rd, MP_RCU_ALIGN, sizeof( mp_rcu_reader_s ) ) != 0 ) {
+            pthread_mutex_unlock( &mp->lock );
+            return NULL;
+        }
+        rd->epoch = 0;
+        rd->next = mp->readers;
+        mp->readers = rd;
+    }
+    rd->used = 1;
+
+    pthread_mutex_unlock( &mp->lock );
+
+    return rd;
+}
+
+
+void mp_rcu_reader_destroy( mp_rcu_t mp, mp_rcu_reader_t rd )
+{
+    pthread_mutex_lock( &mp->lock );
+    __atomic_store_n( &rd->epoch, 0, __ATOMIC_RELEASE );
+    rd->used = 0;
+    pthread_mutex_unlock( &mp->lock );
+}
+
+
+
+/* ------------------------------------------------------------
+ * Access functions:
+ */
+
+void mp_rcu_put( mp_rcu_t mp, const po_d value )
+{
+    mp_rcu_insert( mp, value, NULL, 1 );
+}
+
+
+po_d mp_rcu_get( mp_rcu_t mp, mp_rcu_reader_t rd, const po_d value )
+{
+    return mp_rcu_lookup( mp, rd, value, 1 );
+}
+
+
+po_d mp_rcu_del( mp_rcu_t mp, const po_d value )
+{
+    return mp_rcu_delete( mp, value, 1 );
+}
+
+
+void mp_rcu_put_key( mp_rcu_t mp, const po_d key, const po_d value )
+{
+    mp_rcu_insert( mp, key, value, 2 );
+}
+
+
+po_d mp_rcu_get_key( mp_rcu_t mp, mp_rcu_reader_t rd, const po_d key )
+{
+    return mp_rcu_lookup( mp, rd, key, 2 );
+}
+
+
+po_d mp_rcu_del_key( mp_rcu_t mp, const po_d key )
+{
+    return mp_rcu_delete( mp, key, 2 );
+}
+
+
+void mp_rcu_each( mp_rcu_t mp, mp_rcu_reader_t rd, mp_each_fn_p action, void* arg )
+{
+    mp_rcu_walk( mp, rd, action, NULL, arg );
+}
+
+
+void mp_rcu_each_key( mp_rcu_t mp, mp_rcu_reader_t rd, mp_each_key_fn_p action, void* arg )
+{
+    mp_rcu_walk( mp, rd, NULL, action, arg );
+}
+
+
+void mp_rcu_reclaim( mp_rcu_t mp )
+{
+    pthread_mutex_lock( &mp->lock );
+    mp_rcu_free_retired( mp );
+    pthread_mutex_unlock( &mp->lock );
+}
+
+
+
+/* ------------------------------------------------------------
+ * Internal support:
+ */
+
+
+/**
+ * Allocate empty table.
+ *
+ * @param size Requested size (rounded up to power of two).
+ *
+ * @return Table.
+ */
+static mp_rcu_table_s* mp_rcu_table_new( po_size_t size )
+{
+    mp_rcu_table_s* tab;
+    po_size_t       tab_size;
+    po_size_t       shift;
+
+    tab_size = MP_RCU_MIN_SIZE;
+    shift = 62;
+    while ( tab_size < size ) {
+        tab_size <<= 1;
+        shift--;
+    }
+
+    tab = po_malloc( sizeof( mp_rcu_table_s ) + tab_size * sizeof( po_d ) );
+    tab->size = tab_size;
+    tab->shift = shift;
+    memset( tab->slots, 0, tab_size * sizeof( po_d ) );
+
+    return tab;
+}
+
+
+/**
+ * Return home slot for hash (Fibonacci hashing).
+ *
+ * @param tab    Table.
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Home slot.
+ */
+static po_size_t mp_rcu_home( mp_rcu_table_s* tab, ag_hash_t hash, po_size_t stride )
+{
+    return (po_size_t)( ( (uint64_t)hash * MP_GEN_FIB_MULT ) >> ( tab->shift + stride - 1 ) );
+}
+
+
+/**
+ * Find slot with key, or the first empty slot of probe chain.
+ *
+ * Used by both readers and writer. Tombstones are skipped.
+ *
+ * @param mp     Read-mostly Mapper.
+ * @param tab    Table.
+ * @param key    Key (or Object).
+ * @param hash   Hash of key.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ * @param item   Found key (or Object), NULL if not found.
+ *
+ * @return Slot, or slot count if table is full.
+ */
+static po_size_t mp_rcu_find( mp_rcu_t mp, mp_rcu_table_s* tab, const po_d key, ag_hash_t hash, po_size_t stride, po_d* item )
+{
+    po_size_t cnt;
+    po_size_t slot;
+    po_d      cur;
+
+    cnt = tab->size >> ( stride - 1 );
+    slot = mp_rcu_home( tab, hash, stride );
+
+    for ( po_size_t seen = 0; seen < cnt; seen++ ) {
+
+        cur = __atomic_load_n( &tab->slots[ slot * stride ], __ATOMIC_ACQUIRE );
+
+        if ( cur == NULL ) {
+            *item = NULL;
+            return slot;
+        }
+
+        if ( cur != MP_RCU_TOMB && mp->key_comp( cur, key ) ) {
+            *item = cur;
+            return slot;
+        }
+
+        slot = ( slot + 1 ) & ( cnt - 1 );
+    }
+
+    *item = NULL;
+    return cnt;
+}
+
+
+/**
+ * Enter read section and return current table.
+ *
+ * Reader announces the epoch it entered at. The fence orders the
+ * announcement before the table load, and it pairs with the fence in
+ * mp_rcu_free_retired().
+ *
+ * @param mp Read-mostly Mapper.
+ * @param rd Reader record.
+ *
+ * @return Table.
+ */
+static mp_rcu_table_s* mp_rcu_enter( mp_rcu_t mp, mp_rcu_reader_t rd )
+{
+    __atomic_store_n( &rd->epoch, __atomic_load_n( &mp->epoch, __ATOMIC_ACQUIRE ), __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    return __atomic_load_n( &mp->table, __ATOMIC_ACQUIRE );
+}
+
+
+/**
+ * Leave read section.
+ *
+ * @param rd Reader record.
+ */
+static void mp_rcu_leave( mp_rcu_reader_t rd )
+{
+    __atomic_store_n( &rd->epoch, 0, __ATOMIC_RELEASE );
+}
+
+
+/**
+ * Lookup entry (reader).
+ *
+ * @param mp     Read-mostly Mapper.
+ * @param rd     Reader record.
+ * @param key    Key (or Object).
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Object (Object Mode), value (Key Mode) or NULL.
+ */
+static po_d mp_rcu_lookup( mp_rcu_t mp, mp_rcu_reader_t rd, const po_d key, po_size_t stride )
+{
+    mp_rcu_table_s* tab;
+    po_size_t       slot;
+    ag_hash_t       hash;
+    po_d            item;
+
+    hash = mp->key_hash( key );
+
+    tab = mp_rcu_enter( mp, rd );
+    slot = mp_rcu_find( mp, tab, key, hash, stride, &item );
+    if ( item && stride == 2 )
+        item = __atomic_load_n( &tab->slots[ slot * 2 + 1 ], __ATOMIC_ACQUIRE );
+    mp_rcu_leave( rd );
+
+    return item;
+}
+
+
+/**
+ * Insert or update entry (writer).
+ *
+ * Value is stored before key, hence a reader that sees the key sees
+ * also the value.
+ *
+ * @param mp     Read-mostly Mapper.
+ * @param key    Key (or Object).
+ * @param value  Value (Key Mode only).
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_rcu_insert( mp_rcu_t mp, const po_d key, const po_d value, po_size_t stride )
+{
+    mp_rcu_table_s* tab;
+    po_size_t       slot;
+    ag_hash_t       hash;
+    po_d            item;
+
+    hash = mp->key_hash( key );
+
+    pthread_mutex_lock( &mp->lock );
+
+    if ( ( ( mp->fill_cnt * 100 ) / mp->table->size ) >= mp->fill_lim ) {
+        mp_rcu_rehash( mp, stride );
+    }
+
+    tab = mp->table;
+    slot = mp_rcu_find( mp, tab, key, hash, stride, &item );
+
+    if ( stride == 2 )
+        __atomic_store_n( &tab->slots[ slot * 2 + 1 ], value, __ATOMIC_RELEASE );
+    __atomic_store_n( &tab->slots[ slot * stride ], key, __ATOMIC_RELEASE );
+
+    if ( item == NULL ) {
+        mp->used_cnt += stride;
+        mp->fill_cnt += stride;
+    }
+
+    mp_rcu_free_retired( mp );
+
+    pthread_mutex_unlock( &mp->lock );
+}
+
+
+/**
+ * Delete entry (writer).
+ *
+ * Slot is marked with tombstone. Entries are not moved, since readers
+ * may be probing the same chain.
+ *
+ * @param mp     Read-mostly Mapper.
+ * @param key    Key (or Object).
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ *
+ * @return Deleted Object (Object Mode), value (Key Mode) or NULL.
+ */
+static po_d mp_rcu_delete( mp_rcu_t mp, const po_d key, po_size_t stride )
+{
+    mp_rcu_table_s* tab;
+    po_size_t       slot;
+    ag_hash_t       hash;
+    po_d            item;
+
+    hash = mp->key_hash( key );
+
+    pthread_mutex_lock( &mp->lock );
+
+    tab = mp->table;
+    slot = mp_rcu_find( mp, tab, key, hash, stride, &item );
+    if ( item ) {
+        if ( stride == 2 )
+            item = tab->slots[ slot * 2 + 1 ];
+        __atomic_store_n( &tab->slots[ slot * stride ], MP_RCU_TOMB, __ATOMIC_RELEASE );
+        mp->used_cnt -= stride;
+    }
+
+    mp_rcu_free_retired( mp );
+
+    pthread_mutex_unlock( &mp->lock );
+
+    return item;
+}
+
+
+/**
+ * Run action for each entry (reader).
+ *
+ * @param mp         Read-mostly Mapper.
+ * @param rd         Reader record.
+ * @param action     Object Mode action (or NULL).
+ * @param key_action Key Mode action (or NULL).
+ * @param arg        Argument for action.
+ */
+static void mp_rcu_walk( mp_rcu_t mp, mp_rcu_reader_t rd, mp_each_fn_p action, mp_each_key_fn_p key_action, void* arg )
+{
+    mp_rcu_table_s* tab;
+    po_size_t       stride;
+    po_d            key;
+
+    stride = action ? 1 : 2;
+
+    tab = mp_rcu_enter( mp, rd );
+
+    for ( po_size_t i = 0; i < tab->size; i += stride ) {
+        key = __atomic_load_n( &tab->slots[ i ], __ATOMIC_ACQUIRE );
+        if ( key == NULL || key == MP_RCU_TOMB )
+            continue;
+        if ( action )
+            action( key, arg );
+        else
+            key_action( key, __atomic_load_n( &tab->slots[ i + 1 ], __ATOMIC_ACQUIRE ), arg );
+    }
+
+    mp_rcu_leave( rd );
+}
+
+
+/**
+ * Rehash to new table and publish it (writer).
+ *
+ * Table is doubled if it is filled with entries, otherwise only the
+ * tombstones are purged. Old table is retired.
+ *
+ * @param mp     Read-mostly Mapper.
+ * @param stride Slots per entry (1: Object Mode, 2: Key Mode).
+ */
+static void mp_rcu_rehash( mp_rcu_t mp, po_size_t stride )
+{
+    mp_rcu_table_s*   old;
+    mp_rcu_table_s*   tab;
+    mp_rcu_retired_s* r;
+    po_size_t         size;
+    po_size_t         slot;
+    po_size_t         cnt;
+    po_d              key;
+
+    old = mp->table;
+
+    /* Entries may fill at most half of the fill limit. */
+    size = old->size;
+    while ( ( ( mp->used_cnt * 200 ) / size ) >= mp->fill_lim )
+        size *= 2;
+
+    /* New table is private until published, plain stores suffice. */
+    tab = mp_rcu_table_new( size );
+    cnt = tab->size >> ( stride - 1 );
+    for ( po_size_t i = 0; i < old->size; i += stride ) {
+        key = old->slots[ i ];
+        if ( key == NULL || key == MP_RCU_TOMB )
+            continue;
+        slot = mp_rcu_home( tab, mp->key_hash( key ), stride );
+        while ( tab->slots[ slot * stride ] != NULL )
+            slot = ( slot + 1 ) & ( cnt - 1 );
+        tab->slots[ slot * stride ] = key;
+        if ( stride == 2 )
+            tab->slots[ slot * 2 + 1 ] = old->slots[ i + 1 ];
+    }
+    mp->fill_cnt = mp->used_cnt;
+
+    __atomic_store_n( &mp->table, tab, __ATOMIC_RELEASE );
+    __atomic_store_n( &mp->epoch, mp->epoch + 1, __ATOMIC_RELEASE );
+
+    r = po_malloc( sizeof( mp_rcu_retired_s ) );
+    r->table = old;
+    r->epoch = mp->epoch;
+    r->next = mp->retired;
+    mp->retired = r;
+}
+
+
+/**
+ * Free retired tables that no reader can access (writer).
+ *
+ * Reader which entered before a table was retired has an epoch below
+ * the retire epoch. Table is freed when no such reader exists.
+ *
+ * @param mp Read-mostly Mapper.
+ */
+static void mp_rcu_free_retired( mp_rcu_t mp )
+{
+    mp_rcu_retired_s** rp;
+    mp_rcu_retired_s*  r;
+    uint64_t           min;
+    uint64_t           epoch;
+
+    if ( mp->retired == NULL )
+        return;
+
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+    min = UINT64_MAX;
+    for ( mp_rcu_reader_s* rd = mp->readers; rd; rd = rd->next ) {
+        epoch = __atomic_load_n( &rd->epoch, __ATOMIC_ACQUIRE );
+        if ( epoch != 0 && epoch < min )
+            min = epoch;
+    }
+
+    rp = &mp->retired;
+    while ( *rp ) {
+        r = *rp;
+        if ( r->epoch <= min ) {
+            *rp = r->next;
+            po_free( r->table );
+            po_free( r );
+        } else {
+            rp = &r->next;
+        }
+    }
+}
@@ -0,0 +1,267 @@
+#ifndef MAPPER_RCU_H
+#define MAPPER_RCU_H
+
+/**
+ * @file   mapper_rcu.h
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 20:41:41 2026
+ *
+ * @brief  Mapper RCU - Read-mostly Mapper with lock-free readers.
+ *
+ * Readers take no locks and do no atomic read-modify-write
+ * operations. Writers are serialized with a mutex and publish slot
+ * updates with release stores. Deleted slots are marked with
+ * tombstones (entries are never moved while readers may see the
+ * table) and tombstones are purged by rehash.
+ *
+ * Rehash builds a new table and publishes it with a single pointer
+ * store. The old table is freed only after all readers have left it
+ * (epoch based reclamation). Each reader thread registers a reader
+ * record, which is used to announce the epoch the reader entered
+ * at.
+ *
+ * Note that objects (keys and values) are owned by the user. Objects
+ * removed from the map must not be freed before readers are done with
+ * them.
+ *
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "mapper.h"
+
+
+/** Reader record alignment (cache line size). */
+#define MP_RCU_ALIGN 64
+
+
+/**
+ * Hash table (published to readers).
+ */
+typedef struct mp_rcu_table_s
+{
+    po_size_t size;    /**< Table size (slots, power of two). */
+    po_size_t shift;   /**< Shift for home slot (64 - log2(size)). */
+    po_d      slots[]; /**< Slots. */
+} mp_rcu_table_s;
+
+
+/**
+ * Reader record (one per reader thread).
+ */
+typedef struct mp_rcu_reader_s
+{
+    uint64_t                epoch; /**< Entry epoch (0 if not reading). */
+    int                     used;  /**< Record in use. */
+    struct mp_rcu_reader_s* next;  /**< Next record. */
+} __attribute__( ( aligned( MP_RCU_ALIGN ) ) ) mp_rcu_reader_s;
+
+typedef mp_rcu_reader_s* mp_rcu_reader_t; /**< Reader record pointer. */
+
+
+/**
+ * Retired table waiting for readers to leave.
+ */
+typedef struct mp_rcu_retired_s
+{
+    mp_rcu_table_s*          table; /**< Old table. */
+    uint64_t                 epoch; /**< Epoch when table was retired. */
+    struct mp_rcu_retired_s* next;  /**< Next retired table. */
+} mp_rcu_retired_s;
+
+
+/**
+ * Read-mostly Mapper struct.
+ */
+typedef struct mp_rcu_s
+{
+    mp_rcu_table_s*   table;    /**< Current table. */
+    uint64_t          epoch;    /**< Global epoch. */
+    mp_key_hash_fn_p  key_hash; /**< Key hashing function. */
+    mp_key_comp_fn_p  key_comp; /**< Key compare function. */
+    po_size_t         used_cnt; /**< Number of used slots (entries). */
+    po_size_t         fill_cnt; /**< Number of used and deleted slots. */
+    po_size_t         fill_lim; /**< Storage limit percentage. */
+    mp_rcu_reader_s*  readers;  /**< Reader records. */
+    mp_rcu_retired_s* retired;  /**< Retired tables. */
+    pthread_mutex_t   lock;     /**< Writer lock. */
+} mp_rcu_s;
+
+typedef mp_rcu_s* mp_rcu_t; /**< Read-mostly Mapper pointer. */
+
+
+
+/* ------------------------------------------------------------
+ * Create and destroy:
+ */
+
+
+/**
+ * Create read-mostly Mapper.
+ *
+ * If mp is NULL, descriptor is allocated from heap. This type of
+ * descriptor must be freed by the user after use.
+ *
+ * @param mp       Read-mostly Mapper or NULL.
+ * @param key_hash Key hash function.
+ * @param key_comp Key compare function.
+ * @param size     Size for hash table (rounded up to power of two).
+ * @param fill_lim Fill limit before resize (1-100%).
+ *
+ * @return Read-mostly Mapper.
+ */
+mp_rcu_t mp_rcu_new( mp_rcu_t mp, mp_key_hash_fn_p key_hash, mp_key_comp_fn_p key_comp, po_size_t size, po_size_t fill_lim );
+
+
+/**
+ * Destroy read-mostly Mapper.
+ *
+ * All readers must have finished.
+ *
+ * @param mp Read-mostly Mapper.
+ *
+ * @return NULL.
+ */
+mp_rcu_t mp_rcu_destroy( mp_rcu_t mp );
+
+
+/**
+ * Destroy read-mostly Mapper tables and reader records.
+ *
+ * All readers must have finished.
+ *
+ * @param mp Read-mostly Mapper.
+ */
+void mp_rcu_destroy_table( mp_rcu_t mp );
+
+
+/**
+ * Register reader (thread).
+ *
+ * Reader record is used by one thread at a time.
+ *
+ * @param mp Read-mostly Mapper.
+ *
+ * @return Reader record.
+ */
+mp_rcu_reader_t mp_rcu_reader_new( mp_rcu_t mp );
+
+
+/**
+ * Unregister reader. Record is reused by later registrations.
+ *
+ * @param mp Read-mostly Mapper.
+ * @param rd Reader record.
+ */
+void mp_rcu_reader_destroy( mp_rcu_t mp, mp_rcu_reader_t rd );
+
+
+
+/* ------------------------------------------------------------
+ * Access functions:
+ */
+
+
+/**
+ * Put value to Mapper (writer).
+ *
+ * @param mp    Read-mostly Mapper.
+ * @param value Object including key.
+ */
+void mp_rcu_put( mp_rcu_t mp, const po_d value );
+
+
+/**
+ * Get value from Mapper (reader).
+ *
+ * @param mp    Read-mostly Mapper.
+ * @param rd    Reader record.
+ * @param value Object including key.
+ *
+ * @return Object (or NULL).
+ */
+po_d mp_rcu_get( mp_rcu_t mp, mp_rcu_reader_t rd, const po_d value );
+
+
+/**
+ * Delete value from Mapper (writer).
+ *
+ * @param mp    Read-mostly Mapper.
+ * @param value Object including key.
+ *
+ * @return Deleted Object (or NULL).
+ */
+po_d mp_rcu_del( mp_rcu_t mp, const po_d value );
+
+
+/**
+ * Put key/value to Mapper (writer).
+ *
+ * @param mp    Read-mostly Mapper.
+ * @param key   Key.
+ * @param value Value.
+ */
+void mp_rcu_put_key( mp_rcu_t mp, const po_d key, const po_d value );
+
+
+/**
+ * Get value from Mapper using key (reader).
+ *
+ * @param mp  Read-mostly Mapper.
+ * @param rd  Reader record.
+ * @param key Key.
+ *
+ * @return Value (or NULL).
+ */
+po_d mp_rcu_get_key( mp_rcu_t mp, mp_rcu_reader_t rd, const po_d key );
+
+
+/**
+ * Delete key/value from Mapper (writer).
+ *
+ * @param mp  Read-mostly Mapper.
+ * @param key Key.
+ *
+ * @return Deleted value (or NULL).
+ */
+po_d mp_rcu_del_key( mp_rcu_t mp, const po_d key );
+
+
+/**
+ * Run action for each entry in Object Mode (reader).
+ *
+ * Entries put or deleted during iteration may or may not be visited.
+ *
+ * @param mp     Read-mostly Mapper.
+ * @param rd     Reader record.
+ * @param action Action for entry.
+ * @param arg    Argument for action.
+ */
+void mp_rcu_each( mp_rcu_t mp, mp_rcu_reader_t rd, mp_each_fn_p action, void* arg );
+
+
+/**
+ * Run action for each entry in Key Mode (reader).
+ *
+ * Entries put or deleted during iteration may or may not be visited.
+ *
+ * @param mp     Read-mostly Mapper.
+ * @param rd     Reader record.
+ * @param action Action for entry.
+ * @param arg    Argument for action.
+ */
+void mp_rcu_each_key( mp_rcu_t mp, mp_rcu_reader_t rd, mp_each_key_fn_p action, void* arg );
+
+
+/**
+ * Free retired tables that no reader can access anymore (writer).
+ *
+ * Called automatically after each write.
+ *
+ * @param mp Read-mostly Mapper.
+ */
+void mp_rcu_reclaim( mp_rcu_t mp );
+
+
+#endif
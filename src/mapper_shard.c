@@ -0,0 +1,260 @@
+/**
+ * @file   mapper_shard.c
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 20:37:08 2026
+ *
+ * @brief  Mapper shard - Thread-safe sharded Mapper.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "mapper_shard.h"
+
+
+static mp_shard_slot_s* mp_shard_select( mp_shard_t sh, ag_hash_t hash );
+static void             mp_shard_read_lock( mp_shard_slot_s* shard );
+
+
+
+/* ------------------------------------------------------------
+ * Create and destroy:
+ */
+
+mp_shard_t mp_shard_new( mp_shard_t       sh,
+                         mp_key_hash_fn_p key_hash,
+                         mp_key_comp_fn_p key_comp,
+                         po_size_t        shard_cnt,
+                         po_size_t        size,
+                         po_size_t        fill_lim )
+{
+    po_size_t shard_size;
+    int       own;
+
+    own = ( sh == NULL );
+    if ( own ) {
+        sh = po_malloc( sizeof( mp_shard_s ) );
+    }
+
+    sh->cnt = 1;
+    sh->shift = 64;
+    while ( sh->cnt < shard_cnt ) {
+        sh->cnt <<= 1;
+        sh->shift--;
+    }
+    sh->key_hash = key_hash;
+
+    shard_size = ( size + sh->cnt - 1 ) / sh->cnt;
+    if ( shard_size < 2 )
+        shard_size = 2;
+
+    if ( posix_memalign( (void**)&sh->shards, MP_SHARD_ALIGN, sh->cnt * sizeof( mp_shard_slot_s ) ) != 0 ) {
+        if ( own )
+            po_free( sh );
+        return NULL;
+    }
+
+    for ( po_size_t i = 0; i < sh->cnt; i++ ) {
+        if ( mp_new_full( &sh->shards[ i ].mp, key_hash, key_comp, shard_size, fill_lim ) == NULL ) {
+            /* Table can't be allocated, drop the created shards. */
+            sh->cnt = i;
+            mp_shard_destroy_table( sh );
+            if ( own )
+                po_free( sh );
+            return NULL;
+        }
+        pthread_rwlock_init( &sh->shards[ i ].lock, NULL );
+    }
+
+    return sh;
+}
+
+
+mp_shard_t mp_shard_destroy( mp_shard_t sh )
+{
+    mp_shard_destroy_table( sh );
+    po_free( sh );
+    return NULL;
+}
+
+
+void mp_shard_destroy_table( mp_shard_t sh )
+{
+    for ( po_size_t i = 0; i < sh->cnt; i++ ) {
+        mp_destroy_table( &sh->shards[ i ].mp );
+        pthread_rwlock_destroy( &sh->shards[ i ].lock );
+    }
+    free( sh->shards );
+    sh->shards = NULL;
+}
+
+
+
+/* ------------------------------------------------------------
+ * Access functions:
+ */
+
+void mp_shard_put( mp_shard_t sh, const po_d value )
+{
+    mp_shard_slot_s* shard;
+    ag_hash_t        hash;
+
+    hash = sh->key_hash( value );
+    shard = mp_shard_select( sh, hash );
+    pthread_rwlock_wrlock( &shard->lock );
+    mp_put_hashed( &shard->mp, value, hash );
+    pthread_rwlock_unlock( &shard->lock );
+}
+
+
+po_d mp_shard_get( mp_shard_t sh, const po_d value )
+{
+    mp_shard_slot_s* shard;
+    ag_hash_t        hash;
+    po_d             ret;
+
+    hash = sh->key_hash( value );
+    shard = mp_shard_select( sh, hash );
+    mp_shard_read_lock( shard );
+    ret = mp_get_hashed( &shard->mp, value, hash );
+    pthread_rwlock_unlock( &shard->lock );
+    return ret;
+}
+
+
+po_d mp_shard_del( mp_shard_t sh, const po_d value )
+{
+    mp_shard_slot_s* shard;
+    ag_hash_t        hash;
+    po_d             ret;
+
+    hash = sh->key_hash( value );
+    shard = mp_shard_select( sh, hash );
+    pthread_rwlock_wrlock( &shard->lock );
+    ret = mp_del_hashed( &shard->mp, value, hash );
+    pthread_rwlock_unlock( &shard->lock );
+    return ret;
+}
+
+
+void mp_shard_each( mp_shard_t sh, mp_each_fn_p action, void* arg )
+{
+    for ( po_size_t i = 0; i < sh->cnt; i++ ) {
+        mp_shard_read_lock( &sh->shards[ i ] );
+        mp_each( &sh->shards[ i ].mp, action, arg );
+        pthread_rwlock_unlock( &sh->shards[ i ].lock );
+    }
+}
+
+
+void mp_shard_put_key( mp_shard_t sh, const po_d key, const po_d value )
+{
+    mp_shard_slot_s* shard;
+    ag_hash_t        hash;
+
+    hash = sh->key_hash( key );
+    shard = mp_shard_select( sh, hash );
+    pthread_rwlock_wrlock( &shard->lock );
+    mp_put_key_hashed( &shard->mp, key, value, hash );
+    pthread_rwlock_unlock( &shard->lock );
+}
+
+
+po_d mp_shard_get_key( mp_shard_t sh, const po_d key )
+{
+    mp_shard_slot_s* shard;
+    ag_hash_t        hash;
+    po_d             ret;
+
+    hash = sh->key_hash( key );
+    shard = mp_shard_select( sh, hash );
+    mp_shard_read_lock( shard );
+    ret = mp_get_key_hashed( &shard->mp, key, hash );
+    pthread_rwlock_unlock( &shard->lock );
+    return ret;
+}
+
+
+po_d mp_shard_del_key( mp_shard_t sh, const po_d key )
+{
+    mp_shard_slot_s* shard;
+    ag_hash_t        hash;
+    po_d             ret;
+
+    hash = sh->key_hash( key );
+    shard = mp_shard_select( sh, hash );
+    pthread_rwlock_wrlock( &shard->lock );
+    ret = mp_del_key_hashed( &shard->mp, key, hash );
+    pthread_rwlock_unlock( &shard->lock );
+    return ret;
+}
+
+
+void mp_shard_each_key( mp_shard_t sh, mp_each_key_fn_p action, void* arg )
+{
+    for ( po_size_t i = 0; i < sh->cnt; i++ ) {
+        mp_shard_read_lock( &sh->shards[ i ] );
+        mp_each_key( &sh->shards[ i ].mp, action, arg );
+        pthread_rwlock_unlock( &sh->shards[ i ].lock );
+    }
+}
+
+
+po_size_t mp_shard_used_cnt( mp_shard_t sh )
+{
+    po_size_t cnt;
+
+    cnt = 0;
+    for ( po_size_t i = 0; i < sh->cnt; i++ ) {
+        mp_shard_read_lock( &sh->shards[ i ] );
+        cnt += sh->shards[ i ].mp.used_cnt;
+        pthread_rwlock_unlock( &sh->shards[ i ].lock );
+    }
+
+    return cnt;
+}
+
+
+
+/* ------------------------------------------------------------
+ * Internal support:
+ */
+
+
+/**
+ * Select shard for key (high bits of key hash).
+ *
+ * Key hash is computed by caller, and it is passed also to the shard
+ * Mapper, hence key is hashed once.
+ *
+ * @param sh   Sharded Mapper.
+ * @param hash Key hash.
+ *
+ * @return Shard.
+ */
+static mp_shard_slot_s* mp_shard_select( mp_shard_t sh, ag_hash_t hash )
+{
+    if ( sh->cnt == 1 )
+        return &sh->shards[ 0 ];
+    else
+        return &sh->shards[ (uint64_t)hash >> sh->shift ];
+}
+
+
+/**
+ * Lock shard for lookup.
+ *
+ * With MP_USE_INCR lookups migrate entries between tables, and with
+ * MP_USE_STATS lookups update the counters, hence write lock is
+ * taken.
+ *
+ * @param shard Shard.
+ */
+static void mp_shard_read_lock( mp_shard_slot_s* shard )
+{
+#if MP_USE_INCR == 1 || MP_USE_STATS == 1
+    pthread_rwlock_wrlock( &shard->lock );
+#else
+    pthread_rwlock_rdlock( &shard->lock );
+#endif
+}
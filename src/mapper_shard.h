@@ -0,0 +1,213 @@
+#ifndef MAPPER_SHARD_H
+#define MAPPER_SHARD_H
+
+/**
+ * @file   mapper_shard.h
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 20:37:08 2026
+ *
+ * @brief  Mapper shard - Thread-safe sharded Mapper.
+ *
+ * Key space is split to N independent Mappers (shards) by the high
+ * bits of key hash. Each shard has its own reader/writer lock, hence
+ * threads using different shards do not block each other. Rehash is
+ * done per shard.
+ *
+ * Lookups take the read lock of the shard, except with MP_USE_INCR,
+ * where lookups migrate entries, and with MP_USE_STATS, where lookups
+ * update the (non-atomic) counters. Then lookups take the write lock.
+ *
+ */
+
+#include <pthread.h>
+
+#include "mapper.h"
+
+
+/** Default number of shards. */
+#define MP_SHARD_DEFAULT_CNT 16
+
+/** Shard alignment (cache line size). */
+#define MP_SHARD_ALIGN 64
+
+
+/**
+ * Shard, i.e. Mapper with lock (cache line aligned).
+ */
+typedef struct mp_shard_slot_s
+{
+    pthread_rwlock_t lock; /**< Shard lock. */
+    mp_s             mp;   /**< Shard Mapper. */
+} __attribute__( ( aligned( MP_SHARD_ALIGN ) ) ) mp_shard_slot_s;
+
+
+/**
+ * Sharded Mapper struct.
+ */
+typedef struct mp_shard_s
+{
+    mp_shard_slot_s* shards;   /**< Shards. */
+    po_size_t        cnt;      /**< Number of shards (power of two). */
+    po_size_t        shift;    /**< Shift for shard index (64 - log2(cnt)). */
+    mp_key_hash_fn_p key_hash; /**< Key hashing function. */
+} mp_shard_s;
+
+typedef mp_shard_s* mp_shard_t; /**< Sharded Mapper pointer. */
+
+
+
+/* ------------------------------------------------------------
+ * Create and destroy:
+ */
+
+
+/**
+ * Create sharded Mapper.
+ *
+ * If sh is NULL, descriptor is allocated from heap. This type of
+ * descriptor must be freed by the user after use.
+ *
+ * @param sh        Sharded Mapper or NULL.
+ * @param key_hash  Key hash function.
+ * @param key_comp  Key compare function.
+ * @param shard_cnt Number of shards (rounded up to power of two).
+ * @param size      Total size for hash tables (split between shards).
+ * @param fill_lim  Fill limit before resize (1-100%).
+ *
+ * @return Sharded Mapper (or NULL if shards or their tables can't be
+ *         allocated).
+ */
+mp_shard_t mp_shard_new( mp_shard_t       sh,
+                         mp_key_hash_fn_p key_hash,
+                         mp_key_comp_fn_p key_comp,
+                         po_size_t        shard_cnt,
+                         po_size_t        size,
+                         po_size_t        fill_lim );
+
+
+/**
+ * Destroy sharded Mapper.
+ *
+ * @param sh Sharded Mapper.
+ *
+ * @return NULL.
+ */
+mp_shard_t mp_shard_destroy( mp_shard_t sh );
+
+
+/**
+ * Destroy sharded Mapper shards (storage).
+ *
+ * @param sh Sharded Mapper.
+ */
+void mp_shard_destroy_table( mp_shard_t sh );
+
+
+
+/* ------------------------------------------------------------
+ * Access functions:
+ */
+
+
+/**
+ * Put value to sharded Mapper.
+ *
+ * @param sh    Sharded Mapper.
+ * @param value Object including key.
+ */
+void mp_shard_put( mp_shard_t sh, const po_d value );
+
+
+/**
+ * Get value from sharded Mapper.
+ *
+ * @param sh    Sharded Mapper.
+ * @param value Object including key.
+ *
+ * @return Object (or NULL).
+ */
+po_d mp_shard_get( mp_shard_t sh, const po_d value );
+
+
+/**
+ * Delete value from sharded Mapper.
+ *
+ * @param sh    Sharded Mapper.
+ * @param value Object including key.
+ *
+ * @return Deleted Object (or NULL).
+ */
+po_d mp_shard_del( mp_shard_t sh, const po_d value );
+
+
+/**
+ * Run action for each entry (Object Mode).
+ *
+ * Shards are locked one at a time, hence action must not use the
+ * sharded Mapper.
+ *
+ * @param sh     Sharded Mapper.
+ * @param action Action for entry.
+ * @param arg    Argument for action.
+ */
+void mp_shard_each( mp_shard_t sh, mp_each_fn_p action, void* arg );
+
+
+/**
+ * Put key/value to sharded Mapper.
+ *
+ * @param sh    Sharded Mapper.
+ * @param key   Key.
+ * @param value Value.
+ */
+void mp_shard_put_key( mp_shard_t sh, const po_d key, const po_d value );
+
+
+/**
+ * Get value from sharded Mapper using key.
+ *
+ * @param sh  Sharded Mapper.
+ * @param key Key.
+ *
+ * @return Value (or NULL).
+ */
+po_d mp_shard_get_key( mp_shard_t sh, const po_d key );
+
+
+/**
+ * Delete key/value from sharded Mapper.
+ *
+ * @param sh  Sharded Mapper.
+ * @param key Key.
+ *
+ * @return Deleted value (or NULL).
+ */
+po_d mp_shard_del_key( mp_shard_t sh, const po_d key );
+
+
+/**
+ * Run action for each entry (Key Mode).
+ *
+ * Shards are locked one at a time, hence action must not use the
+ * sharded Mapper.
+ *
+ * @param sh     Sharded Mapper.
+ * @param action Action for entry.
+ * @param arg    Argument for action.
+ */
+void mp_shard_each_key( mp_shard_t sh, mp_each_key_fn_p action, void* arg );
+
+
+/**
+ * Return number of used slots in all shards.
+ *
+ * Key Mode entries consume two slots.
+ *
+ * @param sh Sharded Mapper.
+ *
+ * @return Used slot count.
+ */
+po_size_t mp_shard_used_cnt( mp_shard_t sh );
+
+
+#endif
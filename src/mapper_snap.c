@@ -0,0 +1,465 @@
+/**
+ * @file   mapper_snap.c
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 21:02:19 2026
+ *
+ * @brief  Mapper snapshot - Memory mapped read-only Mapper.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapper_snap.h"
+#include "mapper_gen.h"
+#include "slinky.h"
+
+
+/** Payload record alignment. */
+#define MP_SNAP_ALIGN 8
+
+
+/**
+ * Entries collected for save.
+ */
+typedef struct mp_snap_list_s
+{
+    po_d*     keys;   /**< Keys (or Objects). */
+    po_d*     values; /**< Values (Key Mode). */
+    po_size_t cnt;    /**< Number of entries. */
+} mp_snap_list_s;
+
+
+static int                   mp_snap_save( mp_t mp, const char* path, mp_snap_hdr_s* hdr );
+static void                  mp_snap_collect_fn( po_d value, void* arg );
+static void                  mp_snap_collect_key_fn( po_d key, po_d value, void* arg );
+static po_size_t             mp_snap_rec_skip( mp_snap_type_t type );
+static po_size_t             mp_snap_rec_len( const po_d obj, mp_snap_type_t type, po_size_t size );
+static int                   mp_snap_write_rec( FILE* fh, const po_d obj, mp_snap_type_t type, po_size_t size );
+static int                   mp_snap_off_ok( mp_snap_t snap, uint64_t off, mp_snap_type_t type, po_size_t size );
+static const mp_snap_slot_s* mp_snap_find( mp_snap_t snap, const po_d key );
+
+
+
+/* ------------------------------------------------------------
+ * Create and destroy:
+ */
+
+int mp_save( mp_t mp, const char* path, mp_snap_type_t key_type, po_size_t key_size )
+{
+    mp_snap_hdr_s hdr;
+
+    memset( &hdr, 0, sizeof( mp_snap_hdr_s ) );
+    hdr.stride = 1;
+    hdr.key_type = key_type;
+    hdr.key_size = key_size;
+    hdr.value_type = MP_SNAP_NONE;
+
+    return mp_snap_save( mp, path, &hdr );
+}
+
+
+int mp_save_key( mp_t           mp,
+                 const char*    path,
+                 mp_snap_type_t key_type,
+                 po_size_t      key_size,
+                 mp_snap_type_t value_type,
+                 po_size_t      value_size )
+{
+    mp_snap_hdr_s hdr;
+
+    memset( &hdr, 0, sizeof( mp_snap_hdr_s ) );
+    hdr.stride = 2;
+    hdr.key_type = key_type;
+    hdr.key_size = key_size;
+    hdr.value_type = value_type;
+    hdr.value_size = value_size;
+
+    return mp_snap_save( mp, path, &hdr );
+}
+
+
+mp_snap_t mp_open_mapped( mp_snap_t snap, const char* path, mp_key_hash_fn_p key_hash, mp_key_comp_fn_p key_comp )
+{
+    const mp_snap_hdr_s* hdr;
+    struct stat          st;
+    void*                map;
+    int                  fd;
+
+    fd = open( path, O_RDONLY );
+    if ( fd < 0 )
+        return NULL;
+
+    if ( fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof( mp_snap_hdr_s ) ) {
+        close( fd );
+        errno = EINVAL;
+        return NULL;
+    }
+
+    /* Mapping stays valid after the file is closed. */
+    map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( map == MAP_FAILED )
+        return NULL;
+
+    /* Header is validated here, and payload offsets of slots at
+     * lookup (see mp_snap_off_ok()). */
+    hdr = map;
+    if ( memcmp( hdr->magic, MP_SNAP_MAGIC, sizeof( hdr->magic ) ) != 0
+         || hdr->version != MP_SNAP_VERSION
+         || hdr->file_size != (uint64_t)st.st_size
+         || ( hdr->stride != 1 && hdr->stride != 2 )
+         || hdr->key_type > MP_SNAP_POD
+         || hdr->value_type > MP_SNAP_POD
+         || hdr->slot_cnt < MP_SNAP_MIN_SIZE
+         || ( hdr->slot_cnt & ( hdr->slot_cnt - 1 ) ) != 0
+         || hdr->shift != (uint64_t)( 64 - __builtin_ctzll( hdr->slot_cnt ) )
+         || hdr->slot_cnt > ( hdr->file_size - sizeof( mp_snap_hdr_s ) ) / sizeof( mp_snap_slot_s )
+         || hdr->entry_cnt > hdr->slot_cnt ) {
+        munmap( map, st.st_size );
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if ( snap == NULL ) {
+        snap = po_malloc( sizeof( mp_snap_s ) );
+    }
+    snap->base = map;
+    snap->map_size = st.st_size;
+    snap->hdr = hdr;
+    snap->slots = (const mp_snap_slot_s*)( snap->base + sizeof( mp_snap_hdr_s ) );
+    snap->key_hash = key_hash;
+    snap->key_comp = key_comp;
+
+    return snap;
+}
+
+
+mp_snap_t mp_snap_destroy( mp_snap_t snap )
+{
+    mp_snap_destroy_map( snap );
+    po_free( snap );
+    return NULL;
+}
+
+
+void mp_snap_destroy_map( mp_snap_t snap )
+{
+    if ( snap->base ) {
+        munmap( (void*)snap->base, snap->map_size );
+        snap->base = NULL;
+        snap->hdr = NULL;
+        snap->slots = NULL;
+    }
+}
+
+
+
+/* ------------------------------------------------------------
+ * Access functions:
+ */
+
+const void* mp_snap_get( mp_snap_t snap, const po_d value )
+{
+    const mp_snap_slot_s* slot;
+
+    slot = mp_snap_find( snap, value );
+    if ( slot == NULL )
+        return NULL;
+
+    return snap->base + slot->key;
+}
+
+
+const void* mp_snap_get_key( mp_snap_t snap, const po_d key )
+{
+    const mp_snap_slot_s* slot;
+
+    slot = mp_snap_find( snap, key );
+    if ( slot == NULL || slot->value == 0
+         || !mp_snap_off_ok( snap, slot->value, snap->hdr->value_type, snap->hdr->value_size ) )
+        return NULL;
+
+    return snap->base + slot->value;
+}
+
+
+po_size_t mp_snap_used_cnt( mp_snap_t snap )
+{
+    return snap->hdr->entry_cnt;
+}
+
+
+
+/* ------------------------------------------------------------
+ * Internal support:
+ */
+
+
+/**
+ * Save Mapper entries to file.
+ *
+ * Entries are placed to a new table (power of two, at most half
+ * full) and payloads are written after the table in entry order.
+ *
+ * @param mp   Mapper.
+ * @param path File path.
+ * @param hdr  Header with mode and payload types.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int mp_snap_save( mp_t mp, const char* path, mp_snap_hdr_s* hdr )
+{
+    mp_snap_list_s  list;
+    mp_snap_slot_s* slots;
+    po_size_t       stride;
+    po_size_t       slot;
+    po_size_t       rec;
+    uint64_t        off;
+    ag_hash_t       hash;
+    FILE*           fh;
+    int             ret;
+
+    stride = hdr->stride;
+    list.keys = po_malloc( ( mp->used_cnt / stride + 1 ) * sizeof( po_d ) );
+    list.values = po_malloc( ( mp->used_cnt / stride + 1 ) * sizeof( po_d ) );
+    list.cnt = 0;
+
+    if ( stride == 1 )
+        mp_each( mp, mp_snap_collect_fn, &list );
+    else
+        mp_each_key( mp, mp_snap_collect_key_fn, &list );
+
+    memcpy( hdr->magic, MP_SNAP_MAGIC, sizeof( hdr->magic ) );
+    hdr->version = MP_SNAP_VERSION;
+    hdr->slot_cnt = MP_SNAP_MIN_SIZE;
+    hdr->shift = 64 - __builtin_ctzll( MP_SNAP_MIN_SIZE );
+    while ( hdr->slot_cnt < list.cnt * 2 ) {
+        hdr->slot_cnt <<= 1;
+        hdr->shift--;
+    }
+    hdr->entry_cnt = list.cnt;
+
+    slots = po_malloc( hdr->slot_cnt * sizeof( mp_snap_slot_s ) );
+    memset( slots, 0, hdr->slot_cnt * sizeof( mp_snap_slot_s ) );
+
+    off = sizeof( mp_snap_hdr_s ) + hdr->slot_cnt * sizeof( mp_snap_slot_s );
+    for ( po_size_t i = 0; i < list.cnt; i++ ) {
+
+        hash = mp->key_hash( list.keys[ i ] );
+        slot = ( (uint64_t)hash * MP_GEN_FIB_MULT ) >> hdr->shift;
+        while ( slots[ slot ].key )
+            slot = ( slot + 1 ) & ( hdr->slot_cnt - 1 );
+
+        rec = mp_snap_rec_len( list.keys[ i ], hdr->key_type, hdr->key_size );
+        slots[ slot ].hash = hash;
+        slots[ slot ].key = off + mp_snap_rec_skip( hdr->key_type );
+        off += ( rec + MP_SNAP_ALIGN - 1 ) & ~( (uint64_t)MP_SNAP_ALIGN - 1 );
+
+        if ( hdr->value_type != MP_SNAP_NONE && list.values[ i ] ) {
+            rec = mp_snap_rec_len( list.values[ i ], hdr->value_type, hdr->value_size );
+            slots[ slot ].value = off + mp_snap_rec_skip( hdr->value_type );
+            off += ( rec + MP_SNAP_ALIGN - 1 ) & ~( (uint64_t)MP_SNAP_ALIGN - 1 );
+        }
+    }
+    hdr->file_size = off;
+
+    ret = -1;
+    fh = fopen( path, "wb" );
+    if ( fh ) {
+        ret = 0;
+        if ( fwrite( hdr, sizeof( mp_snap_hdr_s ), 1, fh ) != 1
+             || fwrite( slots, sizeof( mp_snap_slot_s ), hdr->slot_cnt, fh ) != hdr->slot_cnt )
+            ret = -1;
+
+        /* Payloads in the order of offset assignment. */
+        for ( po_size_t i = 0; ret == 0 && i < list.cnt; i++ ) {
+            ret = mp_snap_write_rec( fh, list.keys[ i ], hdr->key_type, hdr->key_size );
+            if ( ret == 0 && hdr->value_type != MP_SNAP_NONE && list.values[ i ] )
+                ret = mp_snap_write_rec( fh, list.values[ i ], hdr->value_type, hdr->value_size );
+        }
+
+        if ( fclose( fh ) != 0 )
+            ret = -1;
+        if ( ret != 0 )
+            remove( path );
+    }
+
+    po_free( slots );
+    po_free( list.values );
+    po_free( list.keys );
+
+    return ret;
+}
+
+
+/**
+ * Collect Object Mode entry.
+ *
+ * @param value Object.
+ * @param arg   Entry list.
+ */
+static void mp_snap_collect_fn( po_d value, void* arg )
+{
+    mp_snap_list_s* list = arg;
+
+    list->keys[ list->cnt ] = value;
+    list->values[ list->cnt ] = NULL;
+    list->cnt++;
+}
+
+
+/**
+ * Collect Key Mode entry.
+ *
+ * @param key   Key.
+ * @param value Value.
+ * @param arg   Entry list.
+ */
+static void mp_snap_collect_key_fn( po_d key, po_d value, void* arg )
+{
+    mp_snap_list_s* list = arg;
+
+    list->keys[ list->cnt ] = key;
+    list->values[ list->cnt ] = value;
+    list->cnt++;
+}
+
+
+/**
+ * Return offset of payload from record start, i.e. size of payload
+ * header.
+ *
+ * @param type Payload type.
+ *
+ * @return Offset.
+ */
+static po_size_t mp_snap_rec_skip( mp_snap_type_t type )
+{
+    if ( type == MP_SNAP_SLINKY )
+        return sizeof( sl_base_s );
+    else
+        return 0;
+}
+
+
+/**
+ * Return record length (without alignment padding).
+ *
+ * @param obj  Payload.
+ * @param type Payload type.
+ * @param size Payload size (MP_SNAP_POD).
+ *
+ * @return Length.
+ */
+static po_size_t mp_snap_rec_len( const po_d obj, mp_snap_type_t type, po_size_t size )
+{
+    if ( type == MP_SNAP_CSTR )
+        return strlen( (const char*)obj ) + 1;
+    else if ( type == MP_SNAP_SLINKY )
+        return sizeof( sl_base_s ) + sl_length( (sl_t)obj ) + 1;
+    else if ( type == MP_SNAP_POD )
+        return size;
+    else
+        return 0;
+}
+
+
+/**
+ * Write record with alignment padding.
+ *
+ * @param fh   File.
+ * @param obj  Payload.
+ * @param type Payload type.
+ * @param size Payload size (MP_SNAP_POD).
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int mp_snap_write_rec( FILE* fh, const po_d obj, mp_snap_type_t type, po_size_t size )
+{
+    static const char pad[ MP_SNAP_ALIGN ] = { 0 };
+    po_size_t         len;
+    po_size_t         pad_len;
+
+    len = mp_snap_rec_len( obj, type, size );
+    pad_len = ( MP_SNAP_ALIGN - ( len & ( MP_SNAP_ALIGN - 1 ) ) ) & ( MP_SNAP_ALIGN - 1 );
+
+    if ( len > 0 && fwrite( (const char*)obj - mp_snap_rec_skip( type ), 1, len, fh ) != len )
+        return -1;
+    if ( pad_len > 0 && fwrite( pad, 1, pad_len, fh ) != pad_len )
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * Check that payload offset is within the payload area of file.
+ *
+ * Payload header (Slinky) must also be within the area, and POD
+ * record must end before the end of file.
+ *
+ * @param snap Snapshot Mapper.
+ * @param off  Payload offset.
+ * @param type Payload type.
+ * @param size Payload size (MP_SNAP_POD).
+ *
+ * @return 1 if offset is valid, else 0.
+ */
+static int mp_snap_off_ok( mp_snap_t snap, uint64_t off, mp_snap_type_t type, po_size_t size )
+{
+    uint64_t first;
+    uint64_t end;
+
+    first = sizeof( mp_snap_hdr_s ) + snap->hdr->slot_cnt * sizeof( mp_snap_slot_s ) + mp_snap_rec_skip( type );
+    end = snap->hdr->file_size;
+
+    if ( off < first || off >= end )
+        return 0;
+    if ( type == MP_SNAP_POD && size > end - off )
+        return 0;
+
+    return 1;
+}
+
+
+/**
+ * Find slot for key.
+ *
+ * Slot with invalid key offset (corrupt file) is not matched.
+ *
+ * @param snap Snapshot Mapper.
+ * @param key  Key (or Object).
+ *
+ * @return Slot (or NULL if not found).
+ */
+static const mp_snap_slot_s* mp_snap_find( mp_snap_t snap, const po_d key )
+{
+    const mp_snap_slot_s* slot;
+    ag_hash_t             hash;
+    po_size_t             cnt;
+    po_size_t             pos;
+
+    hash = snap->key_hash( key );
+    cnt = snap->hdr->slot_cnt;
+    pos = ( (uint64_t)hash * MP_GEN_FIB_MULT ) >> snap->hdr->shift;
+
+    for ( po_size_t seen = 0; seen < cnt; seen++ ) {
+        slot = &snap->slots[ pos ];
+        if ( slot->key == 0 )
+            return NULL;
+        if ( slot->hash == hash
+             && mp_snap_off_ok( snap, slot->key, snap->hdr->key_type, snap->hdr->key_size )
+             && snap->key_comp( (po_d)( snap->base + slot->key ), key ) )
+            return slot;
+        pos = ( pos + 1 ) & ( cnt - 1 );
+    }
+
+    return NULL;
+}
@@ -0,0 +1,219 @@
+#ifndef MAPPER_SNAP_H
+#define MAPPER_SNAP_H
+
+/**
+ * @file   mapper_snap.h
+ * @author agent <agent@local>
+ * @date   Fri Oct 16 21:02:19 2026
+ *
+ * @brief  Mapper snapshot - Memory mapped read-only Mapper.
+ *
+ * Mapper is saved to a file with its keys and values (payloads). The
+ * file is mapped to memory with mp_open_mapped() and lookups are
+ * served directly from the mapping, hence opening takes constant
+ * time regardless of the Mapper size.
+ *
+ * File references payloads with offsets from the file start, hence
+ * the mapping is valid at any address. Payload types are C-string,
+ * Slinky and fixed-size POD record. Slinky payloads include the
+ * Slinky header, hence mapped keys can be hashed and compared with
+ * the Slinky functions (read-only).
+ *
+ * Lookup hashes the key with the key hash function given to
+ * mp_open_mapped(), which must produce the same hashes as the one
+ * used at save. Files use native byte order.
+ *
+ */
+
+#include <stdint.h>
+
+#include "mapper.h"
+
+
+/** Snapshot file magic. */
+#define MP_SNAP_MAGIC "MPSNAP\0\0"
+
+/** Snapshot file format version. */
+#define MP_SNAP_VERSION 1
+
+/** Minimum snapshot table size (slots). */
+#define MP_SNAP_MIN_SIZE 16
+
+
+/**
+ * Payload type.
+ */
+typedef enum mp_snap_type_e
+{
+    MP_SNAP_NONE,   /**< No payload (Object Mode value). */
+    MP_SNAP_CSTR,   /**< C-string. */
+    MP_SNAP_SLINKY, /**< Slinky. */
+    MP_SNAP_POD     /**< Fixed-size record. */
+} mp_snap_type_t;
+
+
+/**
+ * Snapshot file header.
+ */
+typedef struct mp_snap_hdr_s
+{
+    char     magic[ 8 ]; /**< File magic (MP_SNAP_MAGIC). */
+    uint32_t version;    /**< Format version. */
+    uint32_t stride;     /**< Slots per entry (1: Object Mode, 2: Key Mode). */
+    uint32_t key_type;   /**< Key payload type. */
+    uint32_t value_type; /**< Value payload type. */
+    uint64_t key_size;   /**< Key record size (POD). */
+    uint64_t value_size; /**< Value record size (POD). */
+    uint64_t slot_cnt;   /**< Table size (slots, power of two). */
+    uint64_t shift;      /**< Shift for home slot (64 - log2(slot_cnt)). */
+    uint64_t entry_cnt;  /**< Number of entries. */
+    uint64_t file_size;  /**< File size. */
+} mp_snap_hdr_s;
+
+
+/**
+ * Snapshot slot. Payload offsets are from the file start, and zero
+ * key offset marks an empty slot.
+ */
+typedef struct mp_snap_slot_s
+{
+    uint64_t hash;  /**< Key hash. */
+    uint64_t key;   /**< Key offset. */
+    uint64_t value; /**< Value offset (0 for NULL value). */
+} mp_snap_slot_s;
+
+
+/**
+ * Snapshot Mapper struct.
+ */
+typedef struct mp_snap_s
+{
+    const uint8_t*        base;     /**< File mapping. */
+    po_size_t             map_size; /**< Mapping size. */
+    const mp_snap_hdr_s*  hdr;      /**< File header. */
+    const mp_snap_slot_s* slots;    /**< Table (slots). */
+    mp_key_hash_fn_p      key_hash; /**< Key hashing function. */
+    mp_key_comp_fn_p      key_comp; /**< Key compare function. */
+} mp_snap_s;
+
+typedef mp_snap_s* mp_snap_t; /**< Snapshot Mapper pointer. */
+
+
+
+/* ------------------------------------------------------------
+ * Create and destroy:
+ */
+
+
+/**
+ * Save Mapper to file (Object Mode).
+ *
+ * @param mp       Mapper.
+ * @param path     File path.
+ * @param key_type Object payload type.
+ * @param key_size Object size (MP_SNAP_POD).
+ *
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int mp_save( mp_t mp, const char* path, mp_snap_type_t key_type, po_size_t key_size );
+
+
+/**
+ * Save Mapper to file (Key Mode).
+ *
+ * NULL values are saved as NULL, whatever the value type. With
+ * MP_SNAP_NONE all values are saved as NULL.
+ *
+ * @param mp         Mapper.
+ * @param path       File path.
+ * @param key_type   Key payload type.
+ * @param key_size   Key size (MP_SNAP_POD).
+ * @param value_type Value payload type.
+ * @param value_size Value size (MP_SNAP_POD).
+ *
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int mp_save_key( mp_t           mp,
+                 const char*    path,
+                 mp_snap_type_t key_type,
+                 po_size_t      key_size,
+                 mp_snap_type_t value_type,
+                 po_size_t      value_size );
+
+
+/**
+ * Open snapshot file as memory mapped, read-only Mapper.
+ *
+ * If snap is NULL, descriptor is allocated from heap.
+ *
+ * Header is validated at open. Payload offsets are checked at lookup
+ * against the file size, and entries with invalid offsets are not
+ * found.
+ *
+ * @param snap     Snapshot Mapper or NULL.
+ * @param path     File path.
+ * @param key_hash Key hash function.
+ * @param key_comp Key compare function.
+ *
+ * @return Snapshot Mapper (or NULL if file is not a valid snapshot).
+ */
+mp_snap_t mp_open_mapped( mp_snap_t snap, const char* path, mp_key_hash_fn_p key_hash, mp_key_comp_fn_p key_comp );
+
+
+/**
+ * Unmap snapshot and free descriptor.
+ *
+ * @param snap Snapshot Mapper.
+ *
+ * @return NULL.
+ */
+mp_snap_t mp_snap_destroy( mp_snap_t snap );
+
+
+/**
+ * Unmap snapshot.
+ *
+ * @param snap Snapshot Mapper.
+ */
+void mp_snap_destroy_map( mp_snap_t snap );
+
+
+
+/* ------------------------------------------------------------
+ * Access functions:
+ */
+
+
+/**
+ * Get Object from snapshot (Object Mode).
+ *
+ * @param snap  Snapshot Mapper.
+ * @param value Object including key.
+ *
+ * @return Mapped Object (or NULL).
+ */
+const void* mp_snap_get( mp_snap_t snap, const po_d value );
+
+
+/**
+ * Get value from snapshot using key (Key Mode).
+ *
+ * @param snap Snapshot Mapper.
+ * @param key  Key.
+ *
+ * @return Mapped value (or NULL).
+ */
+const void* mp_snap_get_key( mp_snap_t snap, const po_d key );
+
+
+/**
+ * Return number of entries in snapshot.
+ *
+ * @param snap Snapshot Mapper.
+ *
+ * @return Entry count.
+ */
+po_size_t mp_snap_used_cnt( mp_snap_t snap );
+
+
+#endif
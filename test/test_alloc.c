@@ -0,0 +1,201 @@
+#include "unity.h"
+#include "mapper.h"
+#include "mapper_alloc.h"
+
+#include <string.h>
+#include <stdio.h>
+
+
+#define KEY_CNT 20000
+
+char* keys[ KEY_CNT ];
+
+
+void keys_new( void )
+{
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+}
+
+
+void keys_free( void )
+{
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+void check_map( mp_alloc_t alloc )
+{
+    mp_t mp;
+
+    /* Key Mode. */
+    mp = mp_new_alloc( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50, alloc );
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ KEY_CNT - 1 - i ] );
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 2 * KEY_CNT );
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ KEY_CNT - 1 - i ] );
+    }
+    for ( int i = 0; i < KEY_CNT; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i ] ) == keys[ KEY_CNT - 1 - i ] );
+    }
+    for ( int i = 1; i < KEY_CNT; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ KEY_CNT - 1 - i ] );
+    }
+    mp_destroy( mp );
+
+    /* Integer Mode. */
+    mp = mp_new_u64_alloc( NULL, 16, 50, alloc );
+    for ( uint64_t i = 0; i < KEY_CNT; i++ ) {
+        mp_put_u64( mp, i, (po_d)( i + 1 ) );
+    }
+    for ( uint64_t i = 0; i < KEY_CNT; i++ ) {
+        TEST_ASSERT_TRUE( mp_get_u64( mp, i ) == (po_d)( i + 1 ) );
+    }
+    mp_destroy( mp );
+}
+
+
+void test_huge( void )
+{
+    mp_alloc_s alloc;
+
+    keys_new();
+    check_map( mp_alloc_huge( &alloc ) );
+    keys_free();
+}
+
+
+void test_arena( void )
+{
+    mp_arena_t arena;
+    mp_t       mp;
+
+    keys_new();
+
+    /* Region for all tables. */
+    for ( int huge = 0; huge < 2; huge++ ) {
+        arena = mp_arena_new( NULL, 16 * 1024 * 1024, huge );
+        check_map( &arena->alloc );
+        TEST_ASSERT_TRUE( mp_arena_used( arena ) == 0 );
+        mp_arena_destroy( arena );
+    }
+
+    /* Freed tables are reused. */
+    arena = mp_arena_new( NULL, 16 * 1024 * 1024, 0 );
+    mp = mp_new_alloc( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50, &arena->alloc );
+    mp_destroy( mp );
+    mp = mp_new_alloc( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50, &arena->alloc );
+    for ( int i = 0; i < 100; i++ ) {
+        mp_put( mp, keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp_arena_used( arena ) == 1024 * sizeof( po_d ) );
+    TEST_ASSERT_TRUE( (char*)po_data( mp->table ) == arena->base );
+    for ( int i = 0; i < 100; i++ ) {
+        TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+    }
+    mp_destroy( mp );
+    mp_arena_destroy( arena );
+
+    /* Small region, tables overflow to heap. */
+    arena = mp_arena_new( NULL, 4096, 0 );
+    check_map( &arena->alloc );
+    TEST_ASSERT_TRUE( mp_arena_used( arena ) == 0 );
+    mp_arena_destroy( arena );
+
+    keys_free();
+}
+
+
+/* Heap allocator with a byte budget, i.e. an exhausted arena. */
+void* budget_alloc( void* env, po_size_t size )
+{
+    if ( size > *(po_size_t*)env )
+        return NULL;
+    *(po_size_t*)env -= size;
+    return malloc( size );
+}
+
+
+void budget_free( void* env, void* ptr, po_size_t size )
+{
+    *(po_size_t*)env += size;
+    free( ptr );
+}
+
+
+void test_alloc_fail( void )
+{
+    mp_alloc_s alloc;
+    po_size_t  budget;
+    mp_s       ms;
+    mp_t       mp;
+    po_size_t  cnt;
+    int        inserted;
+
+    keys_new();
+
+    alloc.alloc = budget_alloc;
+    alloc.free = budget_free;
+    alloc.env = &budget;
+
+    /* Constructor fails. */
+    budget = 100;
+    TEST_ASSERT_TRUE( mp_new_alloc( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50, &alloc ) == NULL );
+    TEST_ASSERT_TRUE( mp_new_alloc( &ms, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50, &alloc ) == NULL );
+    TEST_ASSERT_TRUE( mp_new_u64_alloc( NULL, 1024, 50, &alloc ) == NULL );
+    TEST_ASSERT_TRUE( budget == 100 );
+
+    /* Growth fails, table is kept and put fails when table is full. */
+    for ( int mode = 0; mode < 3; mode++ ) {
+        budget = 1024 * sizeof( po_d );
+        if ( mode < 2 )
+            mp = mp_new_alloc( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50, &alloc );
+        else
+            mp = mp_new_u64_alloc( NULL, 1024, 50, &alloc );
+        TEST_ASSERT_TRUE( mp != NULL && budget == 0 );
+
+        cnt = 0;
+        for ( int i = 0; i < 2000; i++ ) {
+            po_size_t idx;
+            if ( mode == 0 )
+                idx = mp_put( mp, keys[ i ] );
+            else if ( mode == 1 )
+                idx = mp_put_key( mp, keys[ i ], keys[ i ] );
+            else
+                idx = mp_put_u64( mp, i, keys[ i ] );
+            if ( idx == MP_NO_INDEX )
+                break;
+            cnt++;
+        }
+        TEST_ASSERT_TRUE( po_size( mp->table ) == 1024 );
+        TEST_ASSERT_TRUE( cnt >= 1024 / ( mode == 0 ? 1 : 2 ) / 2 );
+        TEST_ASSERT_TRUE( mp->used_cnt == cnt * ( mode == 0 ? 1 : 2 ) );
+
+        for ( po_size_t i = 0; i < cnt; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            else if ( mode == 1 )
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_get_u64( mp, i ) == keys[ i ] );
+        }
+
+        if ( mode == 0 )
+            TEST_ASSERT_TRUE( mp_get_or_put( mp, keys[ 1999 ], &inserted ) == NULL && !inserted );
+        else if ( mode == 1 )
+            TEST_ASSERT_TRUE( mp_upsert_key( mp, keys[ 1999 ], &inserted ) == NULL && !inserted );
+        else
+            TEST_ASSERT_TRUE( mp_upsert_u64( mp, 1999, &inserted ) == NULL && !inserted );
+
+        mp_destroy( mp );
+        TEST_ASSERT_TRUE( budget == 1024 * sizeof( po_d ) );
+    }
+
+    keys_free();
+}
@@ -4,6 +4,8 @@
 #include <postor.h>
 
 #include <string.h>
+#include <stdio.h>
+#include <pthread.h>
 
 
 char* str1 = "foobar";
@@ -117,7 +119,16 @@ void test_collision( void )
 
         /* Cover rehash. */
         put_fn( mp, str5, str5 );
+#if MP_USE_CUCKOO == 1
+        /* Table has at least two buckets, and entries fit. */
+#if MP_USE_SPLIT == 1
+        TEST_ASSERT_TRUE( po_size( mp->table ) == 4 * MP_CUCKOO_LINE );
+#else
+        TEST_ASSERT_TRUE( po_size( mp->table ) == 2 * MP_CUCKOO_LINE );
+#endif
+#else
         TEST_ASSERT_TRUE( po_size( mp->table ) == ( 8 * ( i + 1 ) ) );
+#endif
 
         mp_destroy( mp );
 
@@ -179,6 +190,7 @@ void test_slinky( void )
     mp_put( &mp, sl3 );
 
     mp_each( &mp, del_each_fn, NULL );
+    mp_release_meta( &mp );
 
 
     /* Key Mode. */
@@ -193,6 +205,7 @@ void test_slinky( void )
     mp_put_key( &mp, sl3, sl3 );
 
     mp_each_key( &mp, del_each_key_fn, NULL );
+    mp_release_meta( &mp );
 }
 
 
@@ -228,3 +241,1511 @@ void test_key( void )
 
     mp_destroy_table( mp );
 }
+
+
+void test_many( void )
+{
+    mp_t  mp;
+    char* keys[ 1000 ];
+    char  miss[ 32 ];
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    /* Object Mode. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 12, 75 );
+#if MP_USE_POW2 == 1 && MP_USE_CUCKOO == 1 && MP_USE_SPLIT == 1
+    /* Two buckets in both halves. */
+    TEST_ASSERT_TRUE( po_size( mp->table ) == 32 );
+#elif MP_USE_POW2 == 1
+    TEST_ASSERT_TRUE( po_size( mp->table ) == 16 );
+#endif
+
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put( mp, keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 1000 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+        TEST_ASSERT_TRUE( mp_get_with_index( mp, mp_get_index( mp, keys[ i ] ) ) == keys[ i ] );
+        sprintf( miss, "miss_%d", i );
+        TEST_ASSERT_TRUE( mp_get( mp, miss ) == NULL );
+    }
+
+    mp_destroy( mp );
+
+
+    /* Key Mode. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 75 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ 999 - i ] );
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 2000 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ 999 - i ] );
+        TEST_ASSERT_TRUE( mp_get_value_with_index( mp, mp_get_key_index( mp, keys[ i ] ) ) == keys[ 999 - i ] );
+        sprintf( miss, "miss_%d", i );
+        TEST_ASSERT_TRUE( mp_get_key( mp, miss ) == NULL );
+    }
+
+    mp_destroy( mp );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+void test_delete( void )
+{
+    mp_t      mp;
+    char*     keys[ 1000 ];
+    po_size_t size;
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    /* Object Mode (full table, no empty slots). */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1000, 100 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put( mp, keys[ i ] );
+    }
+    size = po_size( mp->table );
+
+    for ( int round = 0; round < 3; round++ ) {
+        for ( int i = round; i < 1000; i += 3 ) {
+            TEST_ASSERT_TRUE( mp_del( mp, keys[ i ] ) == keys[ i ] );
+        }
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( ( i % 3 ) <= round )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == NULL );
+            else
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+        }
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 0 );
+    TEST_ASSERT_TRUE( po_size( mp->table ) == size );
+
+    mp_destroy( mp );
+
+
+    /* Key Mode. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 90 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ i ] );
+    }
+
+    for ( int i = 0; i < 1000; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i ] ) == keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 1000 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        if ( i % 2 )
+            TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i ] );
+        else
+            TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == NULL );
+    }
+
+    mp_destroy( mp );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+#if MP_USE_MISS_CNT == 1
+
+void test_robin_hood( void )
+{
+    mp_t  mp;
+    char* keys[ 1000 ];
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 90 );
+        mp_set_miss_cnt( mp, 4 );
+        TEST_ASSERT_TRUE( mp->miss_cnt == 4 );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ i ] );
+        }
+
+        for ( int i = 0; i < 1000; i += 2 ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_del( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i ] ) == keys[ i ] );
+        }
+
+        for ( int i = 0; i < 1000; i++ ) {
+            po_d exp;
+            exp = ( i % 2 ) ? keys[ i ] : NULL;
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == exp );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == exp );
+        }
+
+        /* Index of missing key doesn't resolve to a stored entry. */
+        for ( int i = 0; i < 1000; i += 2 ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get_with_index( mp, mp_get_index( mp, keys[ i ] ) ) == NULL );
+            else
+                TEST_ASSERT_TRUE( mp_get_with_index( mp, mp_get_key_index( mp, keys[ i ] ) ) == NULL );
+        }
+
+        mp_destroy( mp );
+    }
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+#endif
+
+
+#if MP_USE_CUCKOO == 1
+
+void cuckoo_rehash_fn( mp_t mp, void* env )
+{
+    if ( mp )
+        ( *(int*)env )++;
+}
+
+
+uint64_t cuckoo_same_hash( const po_d key )
+{
+    (void)key;
+    return 1234;
+}
+
+
+void test_cuckoo( void )
+{
+    mp_t  mp;
+    char* keys[ 4000 ];
+    int   rehash_cnt;
+
+    for ( int i = 0; i < 4000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    /* Both buckets of missing key are full. */
+    mp = mp_new_full( NULL, cuckoo_same_hash, mp_key_comp_cstr, 1024, 90 );
+    for ( int i = 0; i < 16; i++ ) {
+        mp_put( mp, keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp_get_index( mp, keys[ 16 ] ) == MP_NO_INDEX );
+    TEST_ASSERT_TRUE( mp_get_with_index( mp, MP_NO_INDEX ) == NULL );
+    TEST_ASSERT_TRUE( mp_get_with_index( mp, mp_get_index( mp, keys[ 3 ] ) ) == keys[ 3 ] );
+
+    /* Buckets are cache line aligned, also after growth. */
+    TEST_ASSERT_TRUE( (uintptr_t)po_data( mp->table ) % MP_CUCKOO_ALIGN == 0 );
+    for ( int i = 16; i < 2000; i++ ) {
+        mp_put( mp, keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( (uintptr_t)po_data( mp->table ) % MP_CUCKOO_ALIGN == 0 );
+#if MP_USE_SPLIT == 1
+    /* Value half starts at a bucket boundary too. */
+    TEST_ASSERT_TRUE( (uintptr_t)&po_data( mp->table )[ po_size( mp->table ) / 2 ] % MP_CUCKOO_ALIGN == 0 );
+#endif
+    mp_destroy( mp );
+
+    /* Equal hashes overflow to stash, which grows with the table. */
+    for ( int mode = 0; mode < 2; mode++ ) {
+        mp = mp_new_full( NULL, cuckoo_same_hash, mp_key_comp_cstr, 16, 90 );
+        for ( int i = 0; i < 300; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ 299 - i ] );
+        }
+        TEST_ASSERT_TRUE( mp->used_cnt == (po_size_t)( 300 * ( mode + 1 ) ) );
+        TEST_ASSERT_TRUE( po_size( mp->table ) <= 300 * 64 );
+        for ( int i = 0; i < 300; i += 3 ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_del( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i ] ) == keys[ 299 - i ] );
+        }
+
+        /* Compacted size can't hold the stash, hence rehash restarts
+         * with bigger size, but callback is called once. */
+        rehash_cnt = 0;
+        mp_set_rehash_cb( mp, cuckoo_rehash_fn, &rehash_cnt );
+        if ( mode == 0 )
+            mp_compact( mp );
+        else
+            mp_compact_key( mp );
+        TEST_ASSERT_TRUE( rehash_cnt == 1 );
+        TEST_ASSERT_TRUE( mp->used_cnt == (po_size_t)( 200 * ( mode + 1 ) ) );
+
+        for ( int i = 0; i < 301; i++ ) {
+            po_d exp;
+            exp = ( i % 3 && i < 300 ) ? keys[ ( mode == 0 ) ? i : 299 - i ] : NULL;
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == exp );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == exp );
+        }
+        mp_destroy( mp );
+    }
+
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        /* High fill without growth. */
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 4096, 95 );
+        rehash_cnt = 0;
+        mp_set_rehash_cb( mp, cuckoo_rehash_fn, &rehash_cnt );
+
+        for ( int i = 0; i < 3800 / ( mode + 1 ); i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ 3999 - i ] );
+        }
+
+        TEST_ASSERT_TRUE( rehash_cnt == 0 );
+        TEST_ASSERT_TRUE( po_size( mp->table ) == 4096 );
+
+        for ( int i = 0; i < 3800 / ( mode + 1 ); i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ 3999 - i ] );
+        }
+
+#if MP_USE_STATS == 1
+        mp_stats_s st;
+        if ( mode == 0 )
+            mp_stats( mp, &st );
+        else
+            mp_stats_key( mp, &st );
+        TEST_ASSERT_TRUE( st.entries == (po_size_t)( 3800 / ( mode + 1 ) ) );
+        /* Stash entries count as probe length two. */
+        TEST_ASSERT_TRUE( st.max_probe <= 2 );
+#endif
+
+        /* Fill limit grows the table. */
+        for ( int i = 3800 / ( mode + 1 ); i < 4000; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ 3999 - i ] );
+        }
+
+        TEST_ASSERT_TRUE( rehash_cnt > 0 );
+        TEST_ASSERT_TRUE( mp->used_cnt == (po_size_t)( 4000 * ( mode + 1 ) ) );
+
+        for ( int i = 0; i < 4000; i += 2 ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_del( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i ] ) == keys[ 3999 - i ] );
+        }
+
+        for ( int i = 0; i < 4000; i++ ) {
+            po_d exp;
+            exp = ( i % 2 ) ? keys[ ( mode == 0 ) ? i : 3999 - i ] : NULL;
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == exp );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == exp );
+        }
+
+        /* Index of missing key doesn't resolve to a stored entry. */
+        for ( int i = 0; i < 1000; i += 2 ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get_with_index( mp, mp_get_index( mp, keys[ i ] ) ) == NULL );
+            else
+                TEST_ASSERT_TRUE( mp_get_with_index( mp, mp_get_key_index( mp, keys[ i ] ) ) == NULL );
+        }
+
+        mp_destroy( mp );
+
+        /* Full buckets grow the table before fill limit. */
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 8, 100 );
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ i ] );
+        }
+        TEST_ASSERT_TRUE( mp->used_cnt == (po_size_t)( 1000 * ( mode + 1 ) ) );
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i ] );
+        }
+        mp_destroy( mp );
+    }
+
+    for ( int i = 0; i < 4000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+#endif
+
+
+#if MP_USE_INCR == 1
+
+void rehash_cnt_fn( mp_t mp, void* env )
+{
+    if ( mp )
+        ( *(int*)env )++;
+}
+
+
+void test_incr( void )
+{
+    mp_t  mp;
+    char* keys[ 1000 ];
+    int   rehash_cnt;
+    int   migrating;
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        mp_set_incr_step( mp, 1 );
+        rehash_cnt = 0;
+        migrating = 0;
+        mp_set_rehash_cb( mp, rehash_cnt_fn, &rehash_cnt );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ i ] );
+
+            if ( mp->old )
+                migrating++;
+
+            /* Entries are found from both tables. */
+            if ( mode == 0 ) {
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i / 2 ] ) == keys[ i / 2 ] );
+                if ( i % 3 == 0 )
+                    TEST_ASSERT_TRUE( mp_del( mp, keys[ i / 3 ] ) == keys[ i / 3 ] );
+            } else {
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i / 2 ] ) == keys[ i / 2 ] );
+                if ( i % 3 == 0 )
+                    TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i / 3 ] ) == keys[ i / 3 ] );
+            }
+            if ( i % 3 == 0 ) {
+                if ( mode == 0 )
+                    mp_put( mp, keys[ i / 3 ] );
+                else
+                    mp_put_key( mp, keys[ i / 3 ], keys[ i / 3 ] );
+            }
+        }
+
+        TEST_ASSERT_TRUE( migrating > 0 );
+        TEST_ASSERT_TRUE( mp->used_cnt == (po_size_t)( 1000 * ( mode + 1 ) ) );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i ] );
+        }
+
+        /* Index access completes rehash. */
+        mp_get_index( mp, keys[ 0 ] );
+        TEST_ASSERT_TRUE( mp->old == NULL );
+        TEST_ASSERT_TRUE( ( (po_size_t)16 << rehash_cnt ) == po_size( mp->table ) );
+
+        mp_destroy( mp );
+    }
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+#endif
+
+
+#if MP_USE_THREADS == 1
+
+void rehash_cnt_par_fn( mp_t mp, void* env )
+{
+    if ( mp )
+        ( *(int*)env )++;
+}
+
+
+void test_rehash_threads( void )
+{
+    mp_t  mp;
+    char* keys[ 100000 ];
+    int   rehash_cnt;
+
+    for ( int i = 0; i < 100000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50 );
+        mp_set_rehash_threads( mp, 4 );
+        rehash_cnt = 0;
+        mp_set_rehash_cb( mp, rehash_cnt_par_fn, &rehash_cnt );
+
+        for ( int i = 0; i < 100000; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ i ] );
+        }
+
+        mp_get_index( mp, keys[ 0 ] );
+        TEST_ASSERT_TRUE( mp->used_cnt == (po_size_t)( 100000 * ( mode + 1 ) ) );
+        TEST_ASSERT_TRUE( rehash_cnt > 0 );
+        TEST_ASSERT_TRUE( po_size( mp->table ) >= MP_PAR_REHASH_MIN * 2 );
+
+        for ( int i = 0; i < 100000; i++ ) {
+            if ( mode == 0 ) {
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            } else {
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i ] );
+            }
+        }
+
+        /* Deletion relies on the probe chain layout. */
+        for ( int i = 0; i < 100000; i += 2 ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_del( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i ] ) == keys[ i ] );
+        }
+        for ( int i = 1; i < 100000; i += 2 ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i ] );
+        }
+
+        mp_destroy( mp );
+    }
+
+    for ( int i = 0; i < 100000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+typedef struct each_sum_s
+{
+    uint64_t cnt;
+    uint64_t sum;
+} each_sum_s;
+
+
+void each_sum_fn( po_d value, void* arg )
+{
+    each_sum_s* acc = arg;
+    acc->cnt++;
+    acc->sum += atoi( (char*)value + 4 );
+}
+
+
+void each_sum_key_fn( po_d key, po_d value, void* arg )
+{
+    each_sum_s* acc = arg;
+    acc->cnt++;
+    acc->sum += (uintptr_t)value - (uintptr_t)key;
+}
+
+
+pthread_t each_caller;
+
+void each_caller_key_fn( po_d key, po_d value, void* arg )
+{
+    each_sum_s* acc = arg;
+    if ( !pthread_equal( pthread_self(), each_caller ) )
+        acc->cnt++;
+    acc->sum += (uintptr_t)value - (uintptr_t)key;
+}
+
+
+void each_sum_combine_fn( void* acc, const void* part )
+{
+    ( (each_sum_s*)acc )->cnt += ( (const each_sum_s*)part )->cnt;
+    ( (each_sum_s*)acc )->sum += ( (const each_sum_s*)part )->sum;
+}
+
+
+void test_each_par( void )
+{
+    mp_t       mp;
+    char*      keys[ 100000 ];
+    each_sum_s acc;
+    uint64_t   sum;
+
+    sum = 0;
+    for ( int i = 0; i < 100000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+        sum += i;
+    }
+
+    /* Object Mode. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50 );
+    for ( int i = 0; i < 100000; i++ ) {
+        mp_put( mp, keys[ i ] );
+    }
+
+    memset( &acc, 0, sizeof( acc ) );
+    mp_each_par( mp, each_sum_fn, each_sum_combine_fn, &acc, sizeof( acc ), 4 );
+    TEST_ASSERT_TRUE( acc.cnt == 100000 );
+    TEST_ASSERT_TRUE( acc.sum == sum );
+
+    mp_destroy( mp );
+
+
+    /* Key Mode, value is key plus index. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50 );
+    for ( int i = 0; i < 100000; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ i ] + i );
+    }
+
+    memset( &acc, 0, sizeof( acc ) );
+    mp_each_key_par( mp, each_sum_key_fn, each_sum_combine_fn, &acc, sizeof( acc ), 4 );
+    TEST_ASSERT_TRUE( acc.cnt == 100000 );
+    TEST_ASSERT_TRUE( acc.sum == sum );
+
+    /* Small table is processed by the caller only. */
+    mp_clear( mp );
+    mp_put_key( mp, keys[ 10 ], keys[ 10 ] + 10 );
+    memset( &acc, 0, sizeof( acc ) );
+    mp_each_key_par( mp, each_sum_key_fn, each_sum_combine_fn, &acc, sizeof( acc ), 4 );
+    TEST_ASSERT_TRUE( acc.cnt == 1 );
+    TEST_ASSERT_TRUE( acc.sum == 10 );
+
+    /* Below threshold no threads are used (cnt counts other threads). */
+    mp_destroy( mp );
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1024, 50 );
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ i ] + i );
+    }
+    TEST_ASSERT_TRUE( po_size( mp->table ) / 2 < 2 * MP_PAR_EACH_MIN );
+    each_caller = pthread_self();
+    memset( &acc, 0, sizeof( acc ) );
+    mp_each_key_par( mp, each_caller_key_fn, each_sum_combine_fn, &acc, sizeof( acc ), 4 );
+    TEST_ASSERT_TRUE( acc.cnt == 0 );
+    TEST_ASSERT_TRUE( acc.sum == 999 * 1000 / 2 );
+
+    mp_destroy( mp );
+
+
+    /* Integer Mode. */
+    mp = mp_new_u64( NULL, 1024, 50 );
+    for ( uint64_t i = 0; i < 100000; i++ ) {
+        mp_put_u64( mp, i, (po_d)( i * 2 ) );
+    }
+
+    memset( &acc, 0, sizeof( acc ) );
+    mp_each_key_par( mp, each_sum_key_fn, each_sum_combine_fn, &acc, sizeof( acc ), 4 );
+    TEST_ASSERT_TRUE( acc.cnt == 100000 );
+    TEST_ASSERT_TRUE( acc.sum == sum );
+
+    mp_destroy( mp );
+
+    for ( int i = 0; i < 100000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+#endif
+
+
+#if MP_USE_HASH == 1
+
+int hash_call_cnt = 0;
+
+ag_hash_t hash_cnt_fn( const po_d key )
+{
+    hash_call_cnt++;
+    return mp_key_hash_cstr( key );
+}
+
+
+void test_stored_hash( void )
+{
+    mp_t  mp;
+    mp_t  other;
+    mp_t  dst;
+    char* keys[ 1000 ];
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    mp = mp_new_full( NULL, hash_cnt_fn, mp_key_comp_cstr, 16, 50 );
+    hash_call_cnt = 0;
+
+    /* Key is hashed only once per call, rehash and deletion use
+     * stored hashes. */
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ 999 - i ] );
+    }
+    TEST_ASSERT_TRUE( hash_call_cnt == 1000 );
+    TEST_ASSERT_TRUE( po_size( mp->table ) > 16 );
+
+    for ( int i = 0; i < 1000; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i ] ) == keys[ 999 - i ] );
+    }
+    TEST_ASSERT_TRUE( hash_call_cnt == 1500 );
+
+    for ( int i = 1; i < 1000; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ 999 - i ] );
+    }
+
+    /* Set operations use stored hashes of iterated Mapper. */
+    other = mp_new_full( NULL, hash_cnt_fn, mp_key_comp_cstr, 16, 50 );
+    for ( int i = 0; i < 100; i++ ) {
+        mp_put_key( other, keys[ i ], keys[ i ] );
+    }
+    dst = mp_new_full( NULL, hash_cnt_fn, mp_key_comp_cstr, 16, 50 );
+    hash_call_cnt = 0;
+    TEST_ASSERT_TRUE( mp_union_key( dst, mp, other ) == 550 );
+    TEST_ASSERT_TRUE( mp_intersect_key( NULL, mp, other ) == 50 );
+    TEST_ASSERT_TRUE( hash_call_cnt == 0 );
+    mp_destroy( dst );
+    mp_destroy( other );
+
+    mp_destroy( mp );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+#endif
+
+
+void test_build( void )
+{
+    mp_t      mp;
+    char*     keys[ 1000 ];
+    po_d      in[ 1000 ];
+    po_d      val[ 1000 ];
+    po_size_t size;
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        /* No resize after reserve. */
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        if ( mode == 0 )
+            mp_reserve( mp, 1000 );
+        else
+            mp_reserve_key( mp, 1000 );
+        size = po_size( mp->table );
+        TEST_ASSERT_TRUE( size >= (po_size_t)( mode + 1 ) * 2000 );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ i ] );
+        }
+        TEST_ASSERT_TRUE( po_size( mp->table ) == size );
+        mp_destroy( mp );
+
+
+        /* Build over existing entries, with duplicates in input. */
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        for ( int i = 0; i < 500; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ 999 - i ] );
+        }
+
+        for ( int i = 0; i < 1000; i++ ) {
+            in[ i ] = ( i < 750 ) ? keys[ 250 + i ] : keys[ i - 500 ];
+            val[ i ] = keys[ i ];
+        }
+
+        if ( mode == 0 )
+            mp_build( mp, in, 1000 );
+        else
+            mp_build_key( mp, in, val, 1000 );
+        TEST_ASSERT_TRUE( mp->used_cnt == (po_size_t)( mode + 1 ) * 1000 );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            else if ( i < 250 )
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ 999 - i ] );
+            else if ( i < 500 )
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i + 500 ] );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i - 250 ] );
+        }
+
+        mp_destroy( mp );
+    }
+
+    /* Integer Mode. */
+    mp = mp_new_u64( NULL, 16, 50 );
+    mp_reserve_key( mp, 1000 );
+    size = po_size( mp->table );
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        mp_put_u64( mp, i, keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( po_size( mp->table ) == size );
+    TEST_ASSERT_TRUE( mp_get_u64( mp, 999 ) == keys[ 999 ] );
+    mp_destroy( mp );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+void test_shrink( void )
+{
+    mp_t      mp;
+    char*     keys[ 1000 ];
+    po_size_t size;
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    for ( int mode = 0; mode < 3; mode++ ) {
+
+        if ( mode < 2 )
+            mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        else
+            mp = mp_new_u64( NULL, 16, 50 );
+
+        /* Clamped to quarter of fill limit. */
+        mp_set_shrink_lim( mp, 60 );
+        TEST_ASSERT_TRUE( mp->shrink_lim == 12 );
+        mp_set_shrink_lim( mp, 10 );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else if ( mode == 1 )
+                mp_put_key( mp, keys[ i ], keys[ i ] );
+            else
+                mp_put_u64( mp, i, keys[ i ] );
+        }
+        size = po_size( mp->table );
+
+        /* Delete most, table shrinks. */
+        for ( int i = 10; i < 1000; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_del( mp, keys[ i ] ) == keys[ i ] );
+            else if ( mode == 1 )
+                TEST_ASSERT_TRUE( mp_del_key( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_del_u64( mp, i ) == keys[ i ] );
+        }
+        TEST_ASSERT_TRUE( po_size( mp->table ) < size / 8 );
+
+        /* Put and del around the limit, no thrashing. */
+        size = po_size( mp->table );
+        for ( int n = 0; n < 10; n++ ) {
+            if ( mode == 0 ) {
+                mp_put( mp, keys[ 10 ] );
+                mp_del( mp, keys[ 10 ] );
+            } else if ( mode == 1 ) {
+                mp_put_key( mp, keys[ 10 ], keys[ 10 ] );
+                mp_del_key( mp, keys[ 10 ] );
+            } else {
+                mp_put_u64( mp, 10, keys[ 10 ] );
+                mp_del_u64( mp, 10 );
+            }
+        }
+        TEST_ASSERT_TRUE( po_size( mp->table ) == size );
+
+        for ( int i = 0; i < 10; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            else if ( mode == 1 )
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_get_u64( mp, i ) == keys[ i ] );
+        }
+
+        mp_destroy( mp );
+    }
+
+
+    /* Compaction. */
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ i ] );
+        }
+        for ( int i = 100; i < 1000; i++ ) {
+            if ( mode == 0 )
+                mp_del( mp, keys[ i ] );
+            else
+                mp_del_key( mp, keys[ i ] );
+        }
+        size = po_size( mp->table );
+
+        if ( mode == 0 )
+            mp_compact( mp );
+        else
+            mp_compact_key( mp );
+        TEST_ASSERT_TRUE( po_size( mp->table ) < size / 4 );
+        TEST_ASSERT_TRUE( ( mp->used_cnt * 100 ) / po_size( mp->table ) < 50 );
+
+        for ( int i = 0; i < 1000; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == ( i < 100 ? keys[ i ] : NULL ) );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == ( i < 100 ? keys[ i ] : NULL ) );
+        }
+
+        mp_destroy( mp );
+    }
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+#if MP_USE_STATS == 1
+
+void test_stats( void )
+{
+    mp_t       mp;
+    mp_stats_s st;
+    char*      keys[ 2000 ];
+    po_size_t  sum;
+
+    for ( int i = 0; i < 2000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ i ] );
+    }
+
+    mp_stats_key( mp, &st );
+    TEST_ASSERT_TRUE( st.lookups >= 1000 );
+    TEST_ASSERT_TRUE( st.rehashes > 0 );
+    TEST_ASSERT_TRUE( st.rehash_ns > 0 );
+    TEST_ASSERT_TRUE( st.entries == 1000 );
+    TEST_ASSERT_TRUE( st.slots == po_size( mp->table ) / 2 );
+
+    sum = 0;
+    for ( int i = 0; i < MP_STATS_HIST; i++ ) {
+        sum += st.hist[ i ];
+    }
+    TEST_ASSERT_TRUE( sum == 1000 );
+    TEST_ASSERT_TRUE( st.max_probe < st.slots );
+    TEST_ASSERT_TRUE( st.max_cluster > st.max_probe );
+
+    /* Sample window. */
+    mp_stats_reset( mp );
+    for ( int i = 0; i < 2000; i++ ) {
+        mp_get_key( mp, keys[ i ] );
+    }
+
+    mp_stats_key( mp, &st );
+    TEST_ASSERT_TRUE( st.lookups == 2000 );
+    TEST_ASSERT_TRUE( st.hits == 1000 );
+    TEST_ASSERT_TRUE( st.misses == 1000 );
+    TEST_ASSERT_TRUE( st.probes >= 2000 );
+    TEST_ASSERT_TRUE( st.comps >= 1000 );
+    TEST_ASSERT_TRUE( st.rehashes == 0 );
+    TEST_ASSERT_TRUE( st.entries == 1000 );
+
+    mp_destroy( mp );
+
+
+    /* Integer Mode. */
+    mp = mp_new_u64( NULL, 16, 50 );
+
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        mp_put_u64( mp, i, keys[ i ] );
+    }
+
+    mp_stats_key( mp, &st );
+    TEST_ASSERT_TRUE( st.rehashes > 0 );
+    TEST_ASSERT_TRUE( st.entries == 1000 );
+    TEST_ASSERT_TRUE( st.comps == 0 );
+
+    mp_destroy( mp );
+
+    for ( int i = 0; i < 2000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+#endif
+
+
+void test_batch( void )
+{
+    mp_t      mp;
+    char*     keys[ 1000 ];
+    po_d      res[ 1000 ];
+    po_size_t hits;
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+
+        /* Every other key is stored. */
+        for ( int i = 0; i < 1000; i += 2 ) {
+            if ( mode == 0 )
+                mp_put( mp, keys[ i ] );
+            else
+                mp_put_key( mp, keys[ i ], keys[ 999 - i ] );
+        }
+
+        /* Batch of odd size. */
+        if ( mode == 0 )
+            hits = mp_get_batch( mp, (po_d*)keys, res, 999 );
+        else
+            hits = mp_get_key_batch( mp, (po_d*)keys, res, 999 );
+        TEST_ASSERT_TRUE( hits == 500 );
+
+        for ( int i = 0; i < 999; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( res[ i ] == mp_get( mp, keys[ i ] ) );
+            else
+                TEST_ASSERT_TRUE( res[ i ] == mp_get_key( mp, keys[ i ] ) );
+        }
+
+        mp_destroy( mp );
+    }
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+void sum_u64_fn( uint64_t key, po_d value, void* arg )
+{
+    if ( value )
+        *(uint64_t*)arg += key;
+}
+
+
+void test_u64( void )
+{
+    mp_t     mp;
+    uint64_t sum;
+
+    mp = mp_new_u64( NULL, 16, 50 );
+
+    /* Key zero is a valid key. */
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        mp_put_u64( mp, i * 7, (po_d)( i + 1 ) );
+    }
+    mp_put_u64( mp, 0, (po_d)1 );
+    TEST_ASSERT_TRUE( mp->used_cnt == 2000 );
+
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( mp_get_u64( mp, i * 7 ) == (po_d)( i + 1 ) );
+        TEST_ASSERT_TRUE( mp_get_u64( mp, i * 7 + 1 ) == NULL );
+    }
+
+    for ( uint64_t i = 0; i < 1000; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_del_u64( mp, i * 7 ) == (po_d)( i + 1 ) );
+    }
+    TEST_ASSERT_TRUE( mp_del_u64( mp, 0 ) == NULL );
+    TEST_ASSERT_TRUE( mp->used_cnt == 1000 );
+
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        if ( i % 2 )
+            TEST_ASSERT_TRUE( mp_get_u64( mp, i * 7 ) == (po_d)( i + 1 ) );
+        else
+            TEST_ASSERT_TRUE( mp_get_u64( mp, i * 7 ) == NULL );
+    }
+
+    sum = 0;
+    mp_each_u64( mp, sum_u64_fn, &sum );
+    TEST_ASSERT_TRUE( sum == 7 * 250000 );
+
+    mp_clear( mp );
+    TEST_ASSERT_TRUE( mp_get_u64( mp, 7 ) == NULL );
+
+    mp_destroy( mp );
+}
+
+
+void test_iter( void )
+{
+    mp_t      mp;
+    mp_iter_s it;
+    char*     keys[ 1000 ];
+    char      seen[ 1000 ];
+    po_d      key;
+    po_d      value;
+    int       cnt;
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    /* Object Mode, stop and resume. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put( mp, keys[ i ] );
+    }
+
+    memset( seen, 0, sizeof( seen ) );
+    mp_iter_init( mp, &it );
+    for ( cnt = 0; cnt < 100 && mp_iter_next( &it, &key, &value ); cnt++ ) {
+        TEST_ASSERT_TRUE( key == value );
+        seen[ atoi( (char*)key + 4 ) ]++;
+    }
+    while ( mp_iter_next( &it, &key, NULL ) ) {
+        seen[ atoi( (char*)key + 4 ) ]++;
+        cnt++;
+    }
+    TEST_ASSERT_TRUE( cnt == 1000 );
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( seen[ i ] == 1 );
+    }
+    TEST_ASSERT_TRUE( mp_iter_next( &it, &key, &value ) == 0 );
+
+    mp_destroy( mp );
+
+
+    /* Key Mode, sparse table after deletes. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ 999 - i ] );
+    }
+    for ( int i = 0; i < 1000; i++ ) {
+        if ( i % 100 )
+            mp_del_key( mp, keys[ i ] );
+    }
+
+    memset( seen, 0, sizeof( seen ) );
+    cnt = 0;
+    mp_iter_init_key( mp, &it );
+    while ( mp_iter_next( &it, &key, &value ) ) {
+        TEST_ASSERT_TRUE( atoi( (char*)key + 4 ) == 999 - atoi( (char*)value + 4 ) );
+        seen[ atoi( (char*)key + 4 ) ]++;
+        cnt++;
+    }
+    TEST_ASSERT_TRUE( cnt == 10 );
+    for ( int i = 0; i < 1000; i += 100 ) {
+        TEST_ASSERT_TRUE( seen[ i ] == 1 );
+    }
+
+    mp_clear( mp );
+    mp_iter_init_key( mp, &it );
+    TEST_ASSERT_TRUE( mp_iter_next( &it, NULL, NULL ) == 0 );
+
+    mp_destroy( mp );
+
+
+    /* Integer Mode. */
+    mp = mp_new_u64( NULL, 16, 50 );
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        mp_put_u64( mp, i, (po_d)( i + 1 ) );
+    }
+
+    memset( seen, 0, sizeof( seen ) );
+    cnt = 0;
+    mp_iter_init_key( mp, &it );
+    while ( mp_iter_next( &it, &key, &value ) ) {
+        TEST_ASSERT_TRUE( (uintptr_t)value == (uintptr_t)key + 1 );
+        seen[ (uintptr_t)key ]++;
+        cnt++;
+    }
+    TEST_ASSERT_TRUE( cnt == 1000 );
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( seen[ i ] == 1 );
+    }
+
+    mp_destroy( mp );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+int upsert_comp_cnt = 0;
+
+int upsert_comp_fn( const po_d a, const po_d b )
+{
+    upsert_comp_cnt++;
+    return mp_key_comp_cstr( a, b );
+}
+
+
+void test_upsert( void )
+{
+    mp_t  mp;
+    char* keys[ 1000 ];
+    char  dup[ 32 ];
+    po_d* slot;
+    int   inserted;
+
+    for ( int i = 0; i < 1000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    /* Object Mode, stored Object is kept. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+    for ( int i = 0; i < 1000; i++ ) {
+        slot = mp_get_or_put( mp, keys[ i ], &inserted );
+        TEST_ASSERT_TRUE( inserted == 1 );
+        TEST_ASSERT_TRUE( *slot == keys[ i ] );
+    }
+    strcpy( dup, "key_10" );
+    slot = mp_get_or_put( mp, dup, &inserted );
+    TEST_ASSERT_TRUE( inserted == 0 );
+    TEST_ASSERT_TRUE( *slot == keys[ 10 ] );
+    TEST_ASSERT_TRUE( mp->used_cnt == 1000 );
+    mp_destroy( mp );
+
+
+    /* Key Mode counters, one compare per hit. */
+    mp = mp_new_full( NULL, mp_key_hash_cstr, upsert_comp_fn, 16, 50 );
+    for ( int round = 0; round < 3; round++ ) {
+        for ( int i = 0; i < 1000; i++ ) {
+            slot = mp_upsert_key( mp, keys[ i ], &inserted );
+            TEST_ASSERT_TRUE( inserted == ( round == 0 ) );
+            *slot = (po_d)( (uintptr_t)*slot + 1 );
+        }
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 2000 );
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( (uintptr_t)mp_get_key( mp, keys[ i ] ) == 3 );
+    }
+
+    upsert_comp_cnt = 0;
+    for ( int i = 0; i < 1000; i++ ) {
+        slot = mp_upsert_key( mp, keys[ i ], NULL );
+        *slot = (po_d)( (uintptr_t)*slot + 1 );
+    }
+    TEST_ASSERT_TRUE( upsert_comp_cnt >= 1000 );
+#if MP_USE_HASH == 1
+    TEST_ASSERT_TRUE( upsert_comp_cnt == 1000 );
+#endif
+    mp_destroy( mp );
+
+
+    /* Integer Mode counters. */
+    mp = mp_new_u64( NULL, 16, 50 );
+    for ( int round = 0; round < 2; round++ ) {
+        for ( uint64_t i = 0; i < 1000; i++ ) {
+            slot = mp_upsert_u64( mp, i % 100, &inserted );
+            *slot = (po_d)( (uintptr_t)*slot + 1 );
+        }
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 200 );
+    for ( uint64_t i = 0; i < 100; i++ ) {
+        TEST_ASSERT_TRUE( (uintptr_t)mp_get_u64( mp, i ) == 20 );
+    }
+    mp_destroy( mp );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+void test_put_batch( void )
+{
+    mp_t  mp;
+    mp_t  ref;
+    char* keys[ 3000 ];
+    po_d  objs[ 3000 ];
+    po_d  values[ 3000 ];
+
+    /* Every third key is a duplicate of an earlier key (by content). */
+    for ( int i = 0; i < 3000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", ( i % 3 == 2 ) ? i / 2 : i );
+        objs[ i ] = keys[ i ];
+        values[ i ] = (po_d)(uintptr_t)( i + 1 );
+    }
+
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        ref = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+
+        /* Batch on top of existing entries. */
+        for ( int i = 0; i < 100; i++ ) {
+            if ( mode == 0 ) {
+                mp_put( mp, keys[ i ] );
+            } else {
+                mp_put_key( mp, keys[ i ], NULL );
+            }
+        }
+
+        if ( mode == 0 )
+            mp_put_batch( mp, objs + 100, 2900 );
+        else
+            mp_put_key_batch( mp, objs + 100, values + 100, 2900 );
+
+        for ( int i = 0; i < 3000; i++ ) {
+            if ( mode == 0 )
+                mp_put( ref, keys[ i ] );
+            else
+                mp_put_key( ref, keys[ i ], i < 100 ? NULL : values[ i ] );
+        }
+
+        TEST_ASSERT_TRUE( mp->used_cnt == ref->used_cnt );
+        for ( int i = 0; i < 3000; i++ ) {
+            if ( mode == 0 ) {
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == mp_get( ref, keys[ i ] ) );
+            } else {
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == mp_get_key( ref, keys[ i ] ) );
+            }
+        }
+
+        mp_put_batch( mp, NULL, 0 );
+
+        mp_destroy( mp );
+        mp_destroy( ref );
+    }
+
+    for ( int i = 0; i < 3000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+/* Low entropy hash: three keys per hash value, or more than a
+ * bucket pair holds with cuckoo, which overflows the stash. */
+uint64_t batch_grow_hash( const po_d key )
+{
+#if MP_USE_CUCKOO == 1
+    return (uint64_t)atoi( (const char*)key + 4 ) / 40;
+#else
+    return (uint64_t)atoi( (const char*)key + 4 ) / 3;
+#endif
+}
+
+
+void batch_grow_fn( mp_t mp, void* env )
+{
+    if ( mp )
+        ( *(int*)env )++;
+}
+
+
+void test_put_batch_grow( void )
+{
+    mp_t  mp;
+    char* keys[ 2000 ];
+    po_d  objs[ 2000 ];
+    int   rehash_cnt;
+
+    for ( int i = 0; i < 2000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+        objs[ i ] = keys[ i ];
+    }
+
+    /* Table is reserved at full fill limit, hence Robin Hood and
+     * cuckoo placement grow it in the middle of the batch. */
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        mp = mp_new_full( NULL, batch_grow_hash, mp_key_comp_cstr, 16, 100 );
+#if MP_USE_MISS_CNT == 1
+        mp_set_miss_cnt( mp, 2 );
+#endif
+        if ( mode == 0 )
+            mp_reserve( mp, 2000 );
+        else
+            mp_reserve_key( mp, 2000 );
+
+        rehash_cnt = 0;
+        mp_set_rehash_cb( mp, batch_grow_fn, &rehash_cnt );
+
+        if ( mode == 0 )
+            mp_put_batch( mp, objs, 2000 );
+        else
+            mp_put_key_batch( mp, objs, objs, 2000 );
+
+        for ( int i = 0; i < 2000; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_get( mp, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_get_key( mp, keys[ i ] ) == keys[ i ] );
+        }
+        TEST_ASSERT_TRUE( mp->used_cnt == (po_size_t)( 2000 * ( mode + 1 ) ) );
+
+#if MP_USE_MISS_CNT == 1 || MP_USE_CUCKOO == 1
+        /* Completes incremental rehash. */
+        if ( mode == 0 )
+            mp_get_index( mp, keys[ 0 ] );
+        else
+            mp_get_key_index( mp, keys[ 0 ] );
+        TEST_ASSERT_TRUE( rehash_cnt > 0 );
+#endif
+
+        mp_destroy( mp );
+    }
+
+    for ( int i = 0; i < 2000; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+void test_set_ops( void )
+{
+    mp_t  a;
+    mp_t  b;
+    mp_t  dst;
+    char* keys[ 3000 ];
+
+    for ( int i = 0; i < 3000; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+
+    /* a: 0..1999, b: 1500..2999 (common: 1500..1999). */
+    for ( int mode = 0; mode < 2; mode++ ) {
+
+        a = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        b = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        for ( int i = 0; i < 2000; i++ ) {
+            if ( mode == 0 )
+                mp_put( a, keys[ i ] );
+            else
+                mp_put_key( a, keys[ i ], (po_d)(uintptr_t)( i + 1 ) );
+        }
+        for ( int i = 1500; i < 3000; i++ ) {
+            if ( mode == 0 )
+                mp_put( b, keys[ i ] );
+            else
+                mp_put_key( b, keys[ i ], (po_d)(uintptr_t)( i + 10000 ) );
+        }
+
+        if ( mode == 0 ) {
+            TEST_ASSERT_TRUE( mp_union( NULL, a, b ) == 3000 );
+            TEST_ASSERT_TRUE( mp_intersect( NULL, a, b ) == 500 );
+            TEST_ASSERT_TRUE( mp_intersect( NULL, b, a ) == 500 );
+            TEST_ASSERT_TRUE( mp_diff( NULL, a, b ) == 1500 );
+            TEST_ASSERT_TRUE( mp_diff( NULL, b, a ) == 1000 );
+        } else {
+            TEST_ASSERT_TRUE( mp_union_key( NULL, a, b ) == 3000 );
+            TEST_ASSERT_TRUE( mp_intersect_key( NULL, a, b ) == 500 );
+            TEST_ASSERT_TRUE( mp_diff_key( NULL, a, b ) == 1500 );
+            TEST_ASSERT_TRUE( mp_diff_key( NULL, b, a ) == 1000 );
+        }
+
+        /* Union. */
+        dst = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        if ( mode == 0 ) {
+            TEST_ASSERT_TRUE( mp_union( dst, a, b ) == 3000 );
+            for ( int i = 0; i < 3000; i++ ) {
+                TEST_ASSERT_TRUE( mp_get( dst, keys[ i ] ) == keys[ i ] );
+            }
+        } else {
+            TEST_ASSERT_TRUE( mp_union_key( dst, a, b ) == 3000 );
+            for ( int i = 0; i < 3000; i++ ) {
+                TEST_ASSERT_TRUE( (uintptr_t)mp_get_key( dst, keys[ i ] ) == (uintptr_t)( i < 2000 ? i + 1 : i + 10000 ) );
+            }
+        }
+        TEST_ASSERT_TRUE( dst->used_cnt == (po_size_t)( 3000 * ( mode + 1 ) ) );
+        mp_destroy( dst );
+
+        /* Intersection, smaller map (b) is iterated for both orders. */
+        if ( mode == 0 )
+            mp_del( b, keys[ 2999 ] );
+        else
+            mp_del_key( b, keys[ 2999 ] );
+        dst = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        if ( mode == 0 )
+            TEST_ASSERT_TRUE( mp_intersect( dst, a, b ) == 500 );
+        else
+            TEST_ASSERT_TRUE( mp_intersect_key( dst, a, b ) == 500 );
+        TEST_ASSERT_TRUE( dst->used_cnt == (po_size_t)( 500 * ( mode + 1 ) ) );
+        for ( int i = 1500; i < 2000; i++ ) {
+            if ( mode == 0 ) {
+                TEST_ASSERT_TRUE( mp_get( dst, keys[ i ] ) == keys[ i ] );
+            } else {
+                TEST_ASSERT_TRUE( (uintptr_t)mp_get_key( dst, keys[ i ] ) == (uintptr_t)( i + 1 ) );
+            }
+        }
+        mp_destroy( dst );
+
+        /* Difference. */
+        dst = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+        if ( mode == 0 )
+            TEST_ASSERT_TRUE( mp_diff( dst, b, a ) == 999 );
+        else
+            TEST_ASSERT_TRUE( mp_diff_key( dst, b, a ) == 999 );
+        for ( int i = 2000; i < 2999; i++ ) {
+            if ( mode == 0 ) {
+                TEST_ASSERT_TRUE( mp_get( dst, keys[ i ] ) == keys[ i ] );
+            } else {
+                TEST_ASSERT_TRUE( (uintptr_t)mp_get_key( dst, keys[ i ] ) == (uintptr_t)( i + 10000 ) );
+            }
+        }
+        TEST_ASSERT_TRUE( dst->used_cnt == (po_size_t)( 999 * ( mode + 1 ) ) );
+        mp_destroy( dst );
+
+        mp_destroy( a );
+        mp_destroy( b );
+    }
+
+    for ( int i = 0; i < 3000; i++ ) {
+        free( keys[ i ] );
+    }
+}
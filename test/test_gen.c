@@ -0,0 +1,90 @@
+#include "unity.h"
+#include "mapper_gen.h"
+#include "mapper.h"
+
+#include <string.h>
+#include <stdio.h>
+
+
+#define hash_u64( k ) mp_gen_hash_u64( k )
+#define eq_u64( a, b ) ( ( a ) == ( b ) )
+
+MP_DEFINE_MAP( imap, uint64_t, void*, hash_u64, eq_u64 )
+
+
+#define hash_cstr( k ) mp_key_hash_cstr( (po_d)( k ) )
+#define eq_cstr( a, b ) ( strcmp( ( a ), ( b ) ) == 0 )
+
+MP_DEFINE_MAP( smap, const char*, int, hash_cstr, eq_cstr )
+
+
+void sum_fn( uint64_t key, void* value, void* arg )
+{
+    if ( value )
+        *(uint64_t*)arg += key;
+}
+
+
+void test_int( void )
+{
+    imap_t   m;
+    uint64_t sum;
+    void*    value;
+
+    m = imap_new( NULL, 10, 50 );
+    TEST_ASSERT_TRUE( m->size == 16 );
+
+    /* Key zero is a valid key. */
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( imap_put( m, i, (void*)( i + 1 ) ) == 1 );
+    }
+    TEST_ASSERT_TRUE( imap_put( m, 0, (void*)1 ) == 0 );
+    TEST_ASSERT_TRUE( m->used_cnt == 1000 );
+
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( *imap_get( m, i ) == (void*)( i + 1 ) );
+    }
+    TEST_ASSERT_TRUE( imap_get( m, 1000 ) == NULL );
+
+    for ( uint64_t i = 0; i < 1000; i += 2 ) {
+        TEST_ASSERT_TRUE( imap_del( m, i, &value ) == 1 );
+        TEST_ASSERT_TRUE( value == (void*)( i + 1 ) );
+    }
+    TEST_ASSERT_TRUE( imap_del( m, 0, NULL ) == 0 );
+
+    for ( uint64_t i = 0; i < 1000; i++ ) {
+        if ( i % 2 )
+            TEST_ASSERT_TRUE( *imap_get( m, i ) == (void*)( i + 1 ) );
+        else
+            TEST_ASSERT_TRUE( imap_get( m, i ) == NULL );
+    }
+
+    sum = 0;
+    imap_each( m, sum_fn, &sum );
+    TEST_ASSERT_TRUE( sum == 250000 );
+
+    imap_destroy( m );
+}
+
+
+void test_cstr( void )
+{
+    smap_s m;
+    char   keys[ 100 ][ 32 ];
+
+    smap_new( &m, 4, 75 );
+
+    for ( int i = 0; i < 100; i++ ) {
+        sprintf( keys[ i ], "key_%d", i );
+        smap_put( &m, keys[ i ], i );
+    }
+
+    /* Update in place through value pointer. */
+    ( *smap_get( &m, "key_10" ) ) += 100;
+
+    TEST_ASSERT_TRUE( *smap_get( &m, "key_10" ) == 110 );
+    TEST_ASSERT_TRUE( *smap_get( &m, "key_99" ) == 99 );
+    TEST_ASSERT_TRUE( smap_get( &m, "key_100" ) == NULL );
+
+    smap_destroy_table( &m );
+}
@@ -0,0 +1,222 @@
+#include "unity.h"
+#include "mapper.h"
+#include "mapper_rcu.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+
+
+#define READER_CNT 4
+#define KEY_CNT 4000
+#define STABLE_CNT 500
+#define ROUND_CNT 20
+
+char* keys[ KEY_CNT ];
+
+
+typedef struct
+{
+    mp_rcu_t mp;
+    int      done;
+    int      errors;
+    int      reads;
+} stress_s;
+
+
+void keys_new( void )
+{
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+}
+
+
+void keys_free( void )
+{
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+void count_fn( po_d value, void* arg )
+{
+    if ( value )
+        ( *(int*)arg )++;
+}
+
+
+void count_key_fn( po_d key, po_d value, void* arg )
+{
+    if ( key == value )
+        ( *(int*)arg )++;
+}
+
+
+void test_basic( void )
+{
+    mp_rcu_t        mp;
+    mp_rcu_reader_t rd;
+    int             cnt;
+
+    keys_new();
+
+    /* Object Mode. */
+    mp = mp_rcu_new( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+    rd = mp_rcu_reader_new( mp );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_rcu_put( mp, keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 1000 );
+    TEST_ASSERT_TRUE( mp->table->size >= 2000 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( mp_rcu_get( mp, rd, keys[ i ] ) == keys[ i ] );
+        TEST_ASSERT_TRUE( mp_rcu_get( mp, rd, keys[ 1000 + i ] ) == NULL );
+    }
+
+    for ( int i = 0; i < 1000; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_rcu_del( mp, keys[ i ] ) == keys[ i ] );
+        TEST_ASSERT_TRUE( mp_rcu_del( mp, keys[ i ] ) == NULL );
+    }
+
+    cnt = 0;
+    mp_rcu_each( mp, rd, count_fn, &cnt );
+    TEST_ASSERT_TRUE( cnt == 500 );
+
+    /* No readers inside, all retired tables are freed. */
+    mp_rcu_reclaim( mp );
+    TEST_ASSERT_TRUE( mp->retired == NULL );
+
+    mp_rcu_reader_destroy( mp, rd );
+    mp = mp_rcu_destroy( mp );
+
+
+    /* Key Mode. */
+    mp = mp_rcu_new( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+    rd = mp_rcu_reader_new( mp );
+
+    /* Deleted slots are purged by rehash. */
+    for ( int n = 0; n < 10; n++ ) {
+        for ( int i = 0; i < 100; i++ ) {
+            mp_rcu_put_key( mp, keys[ i ], keys[ i ] );
+        }
+        for ( int i = 0; i < 100; i++ ) {
+            TEST_ASSERT_TRUE( mp_rcu_del_key( mp, keys[ i ] ) == keys[ i ] );
+        }
+    }
+    TEST_ASSERT_TRUE( mp->used_cnt == 0 );
+    TEST_ASSERT_TRUE( mp->table->size <= 1024 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_rcu_put_key( mp, keys[ i ], keys[ i ] );
+    }
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( mp_rcu_get_key( mp, rd, keys[ i ] ) == keys[ i ] );
+    }
+
+    cnt = 0;
+    mp_rcu_each_key( mp, rd, count_key_fn, &cnt );
+    TEST_ASSERT_TRUE( cnt == 1000 );
+
+    mp_rcu_reader_destroy( mp, rd );
+    mp_rcu_destroy( mp );
+
+    keys_free();
+}
+
+
+void* reader_fn( void* arg )
+{
+    stress_s*       st = arg;
+    mp_rcu_reader_t rd;
+    po_d            ret;
+    int             i;
+
+    rd = mp_rcu_reader_new( st->mp );
+
+    i = 0;
+    while ( !__atomic_load_n( &st->done, __ATOMIC_ACQUIRE ) ) {
+
+        /* Stable keys are always found, other keys come and go. */
+        ret = mp_rcu_get_key( st->mp, rd, keys[ i % STABLE_CNT ] );
+        if ( ret != keys[ i % STABLE_CNT ] )
+            __atomic_add_fetch( &st->errors, 1, __ATOMIC_RELAXED );
+
+        ret = mp_rcu_get_key( st->mp, rd, keys[ i ] );
+        if ( ret != NULL && ret != keys[ i ] )
+            __atomic_add_fetch( &st->errors, 1, __ATOMIC_RELAXED );
+
+        i = ( i + 7 ) % KEY_CNT;
+        __atomic_add_fetch( &st->reads, 1, __ATOMIC_RELAXED );
+    }
+
+    mp_rcu_reader_destroy( st->mp, rd );
+
+    return NULL;
+}
+
+
+void test_stress( void )
+{
+    stress_s  st;
+    pthread_t thread[ READER_CNT ];
+    po_size_t size;
+    int       resizes;
+
+    keys_new();
+
+    st.mp = mp_rcu_new( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+    st.done = 0;
+    st.errors = 0;
+    st.reads = 0;
+
+    for ( int i = 0; i < STABLE_CNT; i++ ) {
+        mp_rcu_put_key( st.mp, keys[ i ], keys[ i ] );
+    }
+
+    for ( int i = 0; i < READER_CNT; i++ ) {
+        pthread_create( &thread[ i ], NULL, reader_fn, &st );
+    }
+
+    /* Writer: puts, dels, growth and tombstone purges. */
+    resizes = 0;
+    size = st.mp->table->size;
+    for ( int n = 0; n < ROUND_CNT; n++ ) {
+        for ( int i = STABLE_CNT; i < KEY_CNT; i++ ) {
+            mp_rcu_put_key( st.mp, keys[ i ], keys[ i ] );
+            if ( st.mp->table->size != size ) {
+                size = st.mp->table->size;
+                resizes++;
+            }
+        }
+        for ( int i = STABLE_CNT; i < KEY_CNT; i++ ) {
+            if ( ( i + n ) % 3 != 0 )
+                mp_rcu_del_key( st.mp, keys[ i ] );
+        }
+    }
+
+    __atomic_store_n( &st.done, 1, __ATOMIC_RELEASE );
+
+    for ( int i = 0; i < READER_CNT; i++ ) {
+        pthread_join( thread[ i ], NULL );
+    }
+
+    TEST_ASSERT_TRUE( st.errors == 0 );
+    TEST_ASSERT_TRUE( st.reads > 0 );
+    TEST_ASSERT_TRUE( resizes > 0 );
+
+    for ( int i = 0; i < STABLE_CNT; i++ ) {
+        TEST_ASSERT_TRUE( mp_rcu_del_key( st.mp, keys[ i ] ) == keys[ i ] );
+    }
+
+    mp_rcu_reclaim( st.mp );
+    TEST_ASSERT_TRUE( st.mp->retired == NULL );
+
+    mp_rcu_destroy( st.mp );
+
+    keys_free();
+}
@@ -0,0 +1,213 @@
+#include "unity.h"
+#include "mapper.h"
+#include "mapper_shard.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+
+
+#define THREAD_CNT 4
+#define KEY_CNT 4000
+
+char* keys[ KEY_CNT ];
+
+
+typedef struct
+{
+    mp_shard_t sh;
+    int        id;
+} worker_s;
+
+
+void keys_new( void )
+{
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+}
+
+
+void keys_free( void )
+{
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+void count_fn( po_d value, void* arg )
+{
+    if ( value )
+        ( *(int*)arg )++;
+}
+
+
+void count_key_fn( po_d key, po_d value, void* arg )
+{
+    if ( key == value )
+        ( *(int*)arg )++;
+}
+
+
+void test_basic( void )
+{
+    mp_shard_t sh;
+    int        cnt;
+
+    keys_new();
+
+    sh = mp_shard_new( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 5, 64, 50 );
+    TEST_ASSERT_TRUE( sh->cnt == 8 );
+
+    /* Object Mode. */
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_shard_put( sh, keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp_shard_used_cnt( sh ) == 1000 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( mp_shard_get( sh, keys[ i ] ) == keys[ i ] );
+        TEST_ASSERT_TRUE( mp_shard_get( sh, keys[ 1000 + i ] ) == NULL );
+    }
+
+    for ( int i = 0; i < 1000; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_shard_del( sh, keys[ i ] ) == keys[ i ] );
+    }
+
+    cnt = 0;
+    mp_shard_each( sh, count_fn, &cnt );
+    TEST_ASSERT_TRUE( cnt == 500 );
+
+    sh = mp_shard_destroy( sh );
+
+
+    /* Key Mode. */
+    sh = mp_shard_new( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 1, 64, 50 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        mp_shard_put_key( sh, keys[ i ], keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp_shard_used_cnt( sh ) == 2000 );
+
+    for ( int i = 0; i < 1000; i++ ) {
+        TEST_ASSERT_TRUE( mp_shard_get_key( sh, keys[ i ] ) == keys[ i ] );
+    }
+
+    for ( int i = 0; i < 1000; i += 2 ) {
+        TEST_ASSERT_TRUE( mp_shard_del_key( sh, keys[ i ] ) == keys[ i ] );
+    }
+
+    cnt = 0;
+    mp_shard_each_key( sh, count_key_fn, &cnt );
+    TEST_ASSERT_TRUE( cnt == 500 );
+
+    mp_shard_destroy( sh );
+
+    keys_free();
+}
+
+
+void* worker_fn( void* arg )
+{
+    worker_s* w = arg;
+    int       first = w->id * ( KEY_CNT / THREAD_CNT );
+    int       last = first + ( KEY_CNT / THREAD_CNT );
+
+    /* Put own keys, and read all keys while others are putting. */
+    for ( int i = first; i < last; i++ ) {
+        mp_shard_put_key( w->sh, keys[ i ], keys[ i ] );
+        mp_shard_get_key( w->sh, keys[ ( i * 7 ) % KEY_CNT ] );
+        if ( i % 4 == 0 )
+            mp_shard_del_key( w->sh, keys[ i ] );
+    }
+
+    return NULL;
+}
+
+
+void test_threads( void )
+{
+    mp_shard_t sh;
+    pthread_t  thread[ THREAD_CNT ];
+    worker_s   worker[ THREAD_CNT ];
+
+    keys_new();
+
+    sh = mp_shard_new( NULL, mp_key_hash_cstr, mp_key_comp_cstr, MP_SHARD_DEFAULT_CNT, 64, 50 );
+
+    for ( int i = 0; i < THREAD_CNT; i++ ) {
+        worker[ i ].sh = sh;
+        worker[ i ].id = i;
+        pthread_create( &thread[ i ], NULL, worker_fn, &worker[ i ] );
+    }
+
+    for ( int i = 0; i < THREAD_CNT; i++ ) {
+        pthread_join( thread[ i ], NULL );
+    }
+
+    TEST_ASSERT_TRUE( mp_shard_used_cnt( sh ) == 2 * ( KEY_CNT - KEY_CNT / 4 ) );
+
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        if ( i % 4 == 0 )
+            TEST_ASSERT_TRUE( mp_shard_get_key( sh, keys[ i ] ) == NULL );
+        else
+            TEST_ASSERT_TRUE( mp_shard_get_key( sh, keys[ i ] ) == keys[ i ] );
+    }
+
+    mp_shard_destroy( sh );
+
+    keys_free();
+}
+
+
+int hash_calls;
+
+ag_hash_t count_hash( const po_d key )
+{
+    hash_calls++;
+    return mp_key_hash_cstr( key );
+}
+
+
+void test_hash_once( void )
+{
+    mp_shard_t sh;
+
+    keys_new();
+
+    /* Table does not grow, hence hash is called only by access. */
+    for ( int mode = 0; mode < 2; mode++ ) {
+        sh = mp_shard_new( NULL, count_hash, mp_key_comp_cstr, 4, 4096, 50 );
+        hash_calls = 0;
+        for ( int i = 0; i < 100; i++ ) {
+            if ( mode == 0 )
+                mp_shard_put( sh, keys[ i ] );
+            else
+                mp_shard_put_key( sh, keys[ i ], keys[ i + 100 ] );
+        }
+        TEST_ASSERT_TRUE( hash_calls == 100 );
+
+        hash_calls = 0;
+        for ( int i = 0; i < 100; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_shard_get( sh, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_shard_get_key( sh, keys[ i ] ) == keys[ i + 100 ] );
+        }
+        TEST_ASSERT_TRUE( hash_calls == 100 );
+
+        /* Delete may hash shifted entries too. */
+        for ( int i = 0; i < 100; i++ ) {
+            if ( mode == 0 )
+                TEST_ASSERT_TRUE( mp_shard_del( sh, keys[ i ] ) == keys[ i ] );
+            else
+                TEST_ASSERT_TRUE( mp_shard_del_key( sh, keys[ i ] ) == keys[ i + 100 ] );
+        }
+        TEST_ASSERT_TRUE( mp_shard_used_cnt( sh ) == 0 );
+        sh = mp_shard_destroy( sh );
+    }
+
+    keys_free();
+}
@@ -0,0 +1,212 @@
+#include "unity.h"
+#include "mapper.h"
+#include "mapper_snap.h"
+#include "slinky.h"
+
+#include <string.h>
+#include <stdio.h>
+
+
+#define KEY_CNT 1000
+#define SNAP_FILE "test_snap.mps"
+
+char* keys[ KEY_CNT ];
+
+
+typedef struct
+{
+    int64_t id;
+    double  score;
+} rec_s;
+
+
+void keys_new( void )
+{
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        keys[ i ] = malloc( 32 );
+        sprintf( keys[ i ], "key_%d", i );
+    }
+}
+
+
+void keys_free( void )
+{
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        free( keys[ i ] );
+    }
+}
+
+
+void test_cstr( void )
+{
+    mp_t        mp;
+    mp_snap_t   snap;
+    const char* ret;
+
+    keys_new();
+
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+    for ( int i = 0; i < KEY_CNT; i += 2 ) {
+        mp_put( mp, keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp_save( mp, SNAP_FILE, MP_SNAP_CSTR, 0 ) == 0 );
+    mp_destroy( mp );
+
+    snap = mp_open_mapped( NULL, SNAP_FILE, mp_key_hash_cstr, mp_key_comp_cstr );
+    TEST_ASSERT_TRUE( snap != NULL );
+    TEST_ASSERT_TRUE( mp_snap_used_cnt( snap ) == KEY_CNT / 2 );
+
+    /* Objects are served from the mapping. */
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        ret = mp_snap_get( snap, keys[ i ] );
+        if ( i % 2 == 0 ) {
+            TEST_ASSERT_TRUE( ret != NULL && ret != keys[ i ] );
+            TEST_ASSERT_TRUE( !strcmp( ret, keys[ i ] ) );
+        } else {
+            TEST_ASSERT_TRUE( ret == NULL );
+        }
+    }
+
+    snap = mp_snap_destroy( snap );
+    remove( SNAP_FILE );
+
+    keys_free();
+}
+
+
+void test_slinky_pod( void )
+{
+    mp_t         mp;
+    mp_snap_s    snap;
+    sl_t         sl[ KEY_CNT ];
+    rec_s        rec[ KEY_CNT ];
+    const rec_s* ret;
+    sl_t         key;
+
+    keys_new();
+
+    /* Slinky keys, POD values, every tenth value is NULL. */
+    mp = mp_new_full( NULL, mp_key_hash_slinky, mp_key_comp_slinky, 16, 50 );
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        sl[ i ] = sl_from_str_c( keys[ i ] );
+        rec[ i ].id = i;
+        rec[ i ].score = i * 0.5;
+        mp_put_key( mp, sl[ i ], ( i % 10 == 0 ) ? NULL : &rec[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp_save_key( mp, SNAP_FILE, MP_SNAP_SLINKY, 0, MP_SNAP_POD, sizeof( rec_s ) ) == 0 );
+    mp_destroy( mp );
+
+    TEST_ASSERT_TRUE( mp_open_mapped( &snap, SNAP_FILE, mp_key_hash_slinky, mp_key_comp_slinky ) == &snap );
+    TEST_ASSERT_TRUE( mp_snap_used_cnt( &snap ) == KEY_CNT );
+
+    for ( int i = 0; i < KEY_CNT; i++ ) {
+        ret = mp_snap_get_key( &snap, sl[ i ] );
+        if ( i % 10 == 0 ) {
+            TEST_ASSERT_TRUE( ret == NULL );
+        } else {
+            TEST_ASSERT_TRUE( ret != NULL && ret != &rec[ i ] );
+            TEST_ASSERT_TRUE( ret->id == i && ret->score == i * 0.5 );
+        }
+        sl_del( &sl[ i ] );
+    }
+
+    key = sl_from_str_c( "missing" );
+    TEST_ASSERT_TRUE( mp_snap_get_key( &snap, key ) == NULL );
+    sl_del( &key );
+
+    mp_snap_destroy_map( &snap );
+    remove( SNAP_FILE );
+
+    keys_free();
+}
+
+
+void test_invalid( void )
+{
+    FILE* fh;
+    char  buf[ 256 ];
+
+    TEST_ASSERT_TRUE( mp_open_mapped( NULL, SNAP_FILE, mp_key_hash_cstr, mp_key_comp_cstr ) == NULL );
+
+    memset( buf, 'x', sizeof( buf ) );
+    fh = fopen( SNAP_FILE, "wb" );
+    fwrite( buf, 1, sizeof( buf ), fh );
+    fclose( fh );
+
+    TEST_ASSERT_TRUE( mp_open_mapped( NULL, SNAP_FILE, mp_key_hash_cstr, mp_key_comp_cstr ) == NULL );
+    remove( SNAP_FILE );
+}
+
+
+void test_corrupt( void )
+{
+    mp_t           mp;
+    mp_snap_t      snap;
+    mp_snap_hdr_s  hdr;
+    mp_snap_slot_s slot;
+    FILE*          fh;
+    uint64_t       shift;
+    long           pos;
+    int            found;
+    int            missing;
+
+    keys_new();
+
+    mp = mp_new_full( NULL, mp_key_hash_cstr, mp_key_comp_cstr, 16, 50 );
+    for ( int i = 0; i < 100; i++ ) {
+        mp_put_key( mp, keys[ i ], keys[ i ] );
+    }
+    TEST_ASSERT_TRUE( mp_save_key( mp, SNAP_FILE, MP_SNAP_CSTR, 0, MP_SNAP_CSTR, 0 ) == 0 );
+    mp_destroy( mp );
+
+    fh = fopen( SNAP_FILE, "r+b" );
+    TEST_ASSERT_TRUE( fread( &hdr, sizeof( hdr ), 1, fh ) == 1 );
+
+    /* Shift does not match table size. */
+    shift = hdr.shift;
+    hdr.shift = shift + 1;
+    fseek( fh, 0, SEEK_SET );
+    fwrite( &hdr, sizeof( hdr ), 1, fh );
+    fflush( fh );
+    TEST_ASSERT_TRUE( mp_open_mapped( NULL, SNAP_FILE, mp_key_hash_cstr, mp_key_comp_cstr ) == NULL );
+    hdr.shift = shift;
+    fseek( fh, 0, SEEK_SET );
+    fwrite( &hdr, sizeof( hdr ), 1, fh );
+
+    /* Key offset of first used slot beyond the file, and value offset
+     * of second used slot inside the table. */
+    found = 0;
+    for ( uint64_t i = 0; i < hdr.slot_cnt && found < 2; i++ ) {
+        pos = sizeof( hdr ) + i * sizeof( slot );
+        fseek( fh, pos, SEEK_SET );
+        TEST_ASSERT_TRUE( fread( &slot, sizeof( slot ), 1, fh ) == 1 );
+        if ( slot.key == 0 )
+            continue;
+        if ( found == 0 )
+            slot.key = hdr.file_size + 4096;
+        else
+            slot.value = sizeof( hdr );
+        fseek( fh, pos, SEEK_SET );
+        fwrite( &slot, sizeof( slot ), 1, fh );
+        found++;
+    }
+    fclose( fh );
+
+    snap = mp_open_mapped( NULL, SNAP_FILE, mp_key_hash_cstr, mp_key_comp_cstr );
+    TEST_ASSERT_TRUE( snap != NULL );
+
+    /* Corrupt entries are not found, others are intact. */
+    missing = 0;
+    for ( int i = 0; i < 100; i++ ) {
+        if ( mp_snap_get_key( snap, keys[ i ] ) == NULL )
+            missing++;
+        else
+            TEST_ASSERT_TRUE( !strcmp( mp_snap_get_key( snap, keys[ i ] ), keys[ i ] ) );
+    }
+    TEST_ASSERT_TRUE( missing == 2 );
+
+    snap = mp_snap_destroy( snap );
+    remove( SNAP_FILE );
+
+    keys_free();
+}